@@ -1,22 +1,42 @@
 #define OLC_PGE_APPLICATION
 #define OLC_PGEX_PANZOOM
 
+#include <charconv>
+#include <condition_variable>
 #include <fstream>
 #include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include "olcPixelGameEngine.h"
 #include "olcPGEX_PanZoom.h"
 
+#if !defined(_WIN32)
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
+
 // --- Terminal Types ------------------------------------------------------------------------
 // sourceStart, sourceEnd, clock, clockHalt, buffer, transCollector, transBase, transEmitter
 // transNotOut, gatedIn, gatedWriteEnable, gatedOut
-// ramIn1-8, ramOut1-8, ramWriteEnable, ramAddressIn1-4, bus1-8
-// counterIn1-4, counterOut1-4, counterClock, counterWriteEnable, counterCountEnable,
+// ramIn1-8, ramOut1-8, ramWriteEnable, ramAddressIn1-n, bus1-8
+// counterIn1-n, counterOut1-n, counterClock, counterWriteEnable, counterCountEnable,
 // microcounterIn1-3, microcounterOut1-3, microcounterClock, microcounterReset
 // IRIn1-8, IRIn1-4, IRDecodeOut5-8, IRWriteEnable, displayIn1-8
 // decoderIn1-9, decoderOut1-17, flagsRegIn1-2, flagsRegOut1-2, flagsRegWriteEnable
-// aluInA1-8, aluInB1-8, aluOut1-8, aluSub, aluZeroFlagOut, aluCarryFlagOut
+// aluInA1-n, aluInB1-n, aluOut1-n, aluSub, aluZeroFlagOut, aluCarryFlagOut
+// moduleIn, moduleOut (pins of a module instance)
+// (n is the component width chosen at placement, see componentWidthOptions)
 
 struct Terminal
 {
@@ -32,6 +52,7 @@ struct Component
 	int id;
 	std::string type;
 	olc::vi2d pos;
+	int width = 0;
 };
 
 struct Connection
@@ -45,1405 +66,6167 @@ struct Connection
 	bool state = false;
 };
 
-
-class Viscom : public olc::PixelGameEngine
+// 64 bit FNV-1a of a block of bytes as 16 hex digits.
+std::string contentHash(const void* data, size_t size)
 {
-public:
-	Viscom()
+	uint64_t hash = 14695981039346656037ull;
+
+	for (size_t i = 0; i < size; i++)
 	{
-		sAppName = "viscom";
+		hash ^= ((const unsigned char*)data)[i];
+		hash *= 1099511628211ull;
 	}
 
-public:
-	bool OnUserCreate() override
-	{
-		pz.Create(this);
-		pz.SetOffset({ (float)-ScreenWidth() * 0.5f, (float)-ScreenHeight() * 0.5f });
+	std::stringstream hex;
+	hex << std::hex << std::setw(16) << std::setfill('0') << hash;
+	return hex.str();
+}
 
-		if (!componentBuilderMode)
-		{
-			terminals.push_back({ 1, { 25, 0 }, true, "sourceStart", 1 });
-			terminals.push_back({ 2, { -25, 0 }, false, "sourceEnd", 1 });
-			terminals.push_back({ 3, { -200, 0 }, false, "clock", 1 });
-			terminals.push_back({ lastTerminalId, { -200, -20 }, false, "clockHalt", 0 });
-			lastTerminalId++;
-		}
+// Read-only view of a whole file, memory mapped so it can be used without copying.
+struct MappedFile
+{
+	const uint8_t* data = nullptr;
+	size_t size = 0;
 
-		return true;
+#if defined(_WIN32)
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#else
+	int fd = -1;
+#endif
+
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile()
+	{
+		close();
 	}
 
-	bool OnUserUpdate(float fElapsedTime) override
+	bool open(const std::string& path)
 	{
-		if (GetKey(olc::P).bReleased)
-		{
-			if (!simulationPaused)
-				simulationPaused = true;
-			else
-				simulationPaused = false;
+		close();
 
-			redrawRequired = true;
-		}
+#if defined(_WIN32)
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
 
-		if (GetKey(olc::I).bReleased)
-		{
-			if (!showInfo)
-				showInfo = true;
-			else
-				showInfo = false;
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(file, &fileSize);
+		size = (size_t)fileSize.QuadPart;
 
-			redrawRequired = true;
+		if (size)
+		{
+			mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapping)
+				data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
 		}
+#else
+		fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
 
-		simulateClock();
+		struct stat fileStat;
+		fstat(fd, &fileStat);
+		size = (size_t)fileStat.st_size;
 
-		if (GetKey(olc::Key::UP).bReleased)
+		if (size)
 		{
-			clockSpeed++;
-			redrawRequired = true;
+			void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (view != MAP_FAILED)
+				data = (const uint8_t*)view;
 		}
+#endif
 
-		if (GetKey(olc::Key::DOWN).bReleased)
+		if (size && !data)
 		{
-			if (clockSpeed > 0)
-			{
-				clockSpeed--;
-				redrawRequired = true;
-			}
+			close();
+			return false;
 		}
 
+		return true;
+	}
 
-		if (GetMouseWheel() > 0)
-		{
-			pz.ZoomIn(1.1f);
-			redrawRequired = true;
-		}
+	void close()
+	{
+#if defined(_WIN32)
+		if (data)
+			UnmapViewOfFile(data);
+		if (mapping)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (data)
+			munmap((void*)data, size);
+		if (fd >= 0)
+			::close(fd);
+
+		fd = -1;
+#endif
+
+		data = nullptr;
+		size = 0;
+	}
+};
 
-		if (GetMouseWheel() < 0)
-		{
-			pz.ZoomOut(0.9f);
-			redrawRequired = true;
-		}
+// Walks the comma separated text saves and module files in place. Text fields are views into the buffer and numbers
+// go through std::from_chars, so the reader itself allocates nothing, only the fields a caller copies out do. Stops at
+// the first problem and keeps it in error with its line and column.
+struct CsvReader
+{
+	const char* cursor;
+	const char* end;
+	const char* lineStart;
+	int line = 1;
+	std::string source;  // File name the errors start with
+	std::string error;
+
+	CsvReader(const char* data, size_t size, std::string source) : cursor(data), end(data + size), lineStart(data), source(source)
+	{
+	}
 
-		if (GetKey(olc::Z).bReleased)
+	// Moves to the start of the next record past any blank lines, false at the end or after an error.
+	bool nextRecord()
+	{
+		while (error.empty() && cursor < end && (*cursor == '\n' || *cursor == '\r'))
 		{
-			pz.SetScale({ 1.0f, 1.0f });
-			redrawRequired = true;
-		}
+			if (*cursor == '\n')
+			{
+				line++;
+				lineStart = cursor + 1;
+			}
 
-		if (GetKey(olc::Q).bHeld)
-		{
-			pz.ZoomOut(1000);
-			redrawRequired = true;
+			cursor++;
 		}
 
-		// Pan
-		if (GetMouse(2).bHeld)
-			redrawRequired = true;
+		return error.empty() && cursor < end;
+	}
 
-		if (GetMouse(2).bPressed)
-			pz.StartPan();
+	bool atLineEnd() const
+	{
+		return cursor == end || *cursor == '\n' || *cursor == '\r';
+	}
 
-		if (GetMouse(2).bReleased)
-			pz.StopPan();
+	bool fail(const char* message)
+	{
+		if (error.empty())
+			error = source + ":" + std::to_string(line) + ":" + std::to_string(cursor - lineStart + 1) + ": " + message;
 
-		// Draw mouse guides
-		if (GetKey(olc::X).bHeld || GetKey(olc::X).bReleased)
-		{
-			redrawRequired = true;
-		}
+		cursor = end;
+		return false;
+	}
 
+	// Steps over the comma after a field, the last field on a line has none.
+	bool separator()
+	{
+		if (atLineEnd())
+			return true;
 
-		pz.Update(fElapsedTime);
+		if (*cursor != ',')
+			return fail("expected a comma");
 
-		if (GetKey(olc::Key::R).bReleased)
-		{
-			programRAM();
-			updateSimulation = true;
-			redrawRequired = true;
-		}
+		cursor++;
+		return true;
+	}
 
-		// -------------------------------------------------------------------
-		// Run Logic Simulation
-		//
-		//
+	bool number(int& value)
+	{
+		auto result = std::from_chars(cursor, end, value);
 
-		std::vector<int> newVisitedTerminalIds;
-		std::vector<int> newVisitedTerminalIdsTwo;
+		if (result.ec != std::errc())
+			return fail("expected a number");
 
-		std::vector<int> previousTerminalsState = {};
-		for (auto terminal : terminals)
-		{
-			previousTerminalsState.push_back(terminal.state);
-		}
+		cursor = result.ptr;
+		return separator();
+	}
 
-		if (updateSimulation && !simulationPaused)
-		{
-			redrawRequired = true;
+	// A number that older files leave off the end of the line, e.g. the width in "x,y,width". Missing reads as 0.
+	bool optionalNumber(int& value)
+	{
+		value = 0;
+		return atLineEnd() || number(value);
+	}
 
-			for (auto& connection : connections)
-				connection.state = false;
+	std::string_view text()
+	{
+		const char* start = cursor;
+		while (!atLineEnd() && *cursor != ',')
+			cursor++;
 
-			for (auto& terminal : terminals)
-				if (terminal.type != "sourceStart" && terminal.type != "gatedOut" && !("aluOut1" <= terminal.type && terminal.type <= "aluOut8") && !("ramOut1" <= terminal.type && terminal.type <= "ramOut8") && !("counterOut1" <= terminal.type && terminal.type <= "counterOut4") && !("microcounterOut1" <= terminal.type && terminal.type <= "microcounterOut3") && !("IROut1" <= terminal.type && terminal.type <= "IROut4") && !("IRDecodeOut5" <= terminal.type && terminal.type <= "IRDecodeOut8") && !(terminal.type.find("decoderOut") != std::string::npos) && !(terminal.type == "flagsRegOut1") && !(terminal.type == "flagsRegOut2") && !(terminal.type == "aluZeroFlagOut") && !(terminal.type == "aluCarryFlagOut"))
-				{
-					terminal.state = false;
-				}
-				else if (terminal.type == "clock")
-					terminal.state = clockState;
+		std::string_view field(start, cursor - start);
+		separator();
+		return field;
+	}
 
-			counterCounted = false;
-			microcounterCounted = false;
+	bool endRecord()
+	{
+		return atLineEnd() || fail("expected the end of the line");
+	}
+};
 
-			std::vector<int> transistorsToSimulate;
-			std::vector<int> gatedLatchesToSimulate;
-			std::vector<Terminal*> activeTerminals;
-			std::vector<Connection*> activeConnections;
+// RAM contents, one byte per address with bit 7 as ramIn1/ramOut1. The address space is split into pages that are
+// only allocated when first written, so a 64 KiB RAM holding a short program costs a single page. A mapped image
+// backs any page that has not been written yet.
+struct RamStore
+{
+	static const size_t pageSize = 4096;
 
-			updateSourceConnections();
+	size_t byteCount = 0;
+	std::vector<std::unique_ptr<uint8_t[]>> pages;
+	std::shared_ptr<MappedFile> image;
 
-			for (auto currentConnection : sourceConnections)
-			{
-				if (currentConnection->terminalA == 1)
-					currentConnection->state = true;
+	size_t size() const
+	{
+		return byteCount;
+	}
 
-				if (currentConnection->terminalA == 3)
-					currentConnection->state = clockState;
+	void resize(size_t newByteCount)
+	{
+		byteCount = newByteCount;
+		pages.resize((newByteCount + pageSize - 1) / pageSize);
+	}
 
-				Terminal* currentTerminalA = findTerminal(currentConnection->terminalA);
-				Terminal* currentTerminalB = findTerminal(currentConnection->terminalB);
+	void clear()
+	{
+		image.reset();
 
-				newVisitedTerminalIds.push_back(currentConnection->terminalA);
+		for (auto& page : pages)
+			page.reset();
+	}
 
-				if ("aluOut1" <= currentTerminalA->type && currentTerminalA->type <= "aluOut8")
-					currentConnection->state = currentTerminalA->state;
+	uint8_t read(size_t address) const
+	{
+		if (address >= byteCount)
+			return 0;
 
-				if ("ramOut1" <= currentTerminalA->type && currentTerminalA->type <= "ramOut8")
-					currentConnection->state = currentTerminalA->state;
+		const auto& page = pages[address / pageSize];
 
-				if ("counterOut1" <= currentTerminalA->type && currentTerminalA->type <= "counterOut4")
-					currentConnection->state = currentTerminalA->state;
+		if (page)
+			return page[address % pageSize];
 
-				if ("microcounterOut1" <= currentTerminalA->type && currentTerminalA->type <= "microcounterOut3")
-					currentConnection->state = currentTerminalA->state;
+		if (image && address < image->size)
+			return image->data[address];
 
-				if ("IROut1" <= currentTerminalA->type && currentTerminalA->type <= "IROut4")
-					currentConnection->state = currentTerminalA->state;
+		return 0;
+	}
 
-				if ("IRDecodeOut5" <= currentTerminalA->type && currentTerminalA->type <= "IRDecodeOut8")
-					currentConnection->state = currentTerminalA->state;
+	void write(size_t address, uint8_t value)
+	{
+		if (address >= byteCount)
+			return;
 
-				if (currentTerminalA->type.find("decoderOut") != std::string::npos)
-					currentConnection->state = currentTerminalA->state;
+		auto& page = pages[address / pageSize];
 
-				if ("flagsRegOut1" <= currentTerminalA->type && currentTerminalA->type <= "flagsRegOut2")
-					currentConnection->state = currentTerminalA->state;
+		if (!page)
+		{
+			if (read(address) == value)
+				return;
 
-				if (currentTerminalA->type == "aluZeroFlagOut" || currentTerminalA->type == "aluCarryFlagOut")
-					currentConnection->state = currentTerminalA->state;
+			page.reset(new uint8_t[pageSize]());
 
-				if (currentTerminalA->type == "gatedOut")
-					gatedLatchesToSimulate.push_back(currentTerminalA->componentId);
+			size_t pageStart = address - address % pageSize;
+			if (image && pageStart < image->size)
+				memcpy(page.get(), image->data + pageStart, std::min(size_t(pageSize), image->size - pageStart));
+		}
 
-				if (currentTerminalB)
-				{
-					newVisitedTerminalIds.push_back(currentConnection->terminalB);
-					currentTerminalB->state = currentConnection->state;
+		page[address % pageSize] = value;
+	}
 
-					if (currentTerminalB->type == "buffer")
-						activeTerminals.push_back(currentTerminalB);
-					else if (currentTerminalB->type == "transCollector" || currentTerminalB->type == "transEmitter" || currentTerminalB->type == "transBase")
-						transistorsToSimulate.push_back(currentTerminalB->componentId);
-					else if (currentTerminalB->type == "gatedIn" || currentTerminalB->type == "gatedWriteEnable" || currentTerminalB->type == "gatedOut")
-						gatedLatchesToSimulate.push_back(currentTerminalB->componentId);
+	// Bit 0 is the most significant bit, matching the left to right order the RAM is drawn in.
+	bool readBit(size_t address, int bit) const
+	{
+		return (read(address) >> (7 - bit)) & 1;
+	}
 
-				}
-			}
+	void toggleBit(size_t address, int bit)
+	{
+		write(address, read(address) ^ (0x80 >> bit));
+	}
 
-			while ((transistorsToSimulate.size() || gatedLatchesToSimulate.size() || activeTerminals.size()))
-			{
-				for (auto transistorId : transistorsToSimulate)
-				{
-					Terminal* thisNotOut = findTerminalByComponent(transistorId, "transNotOut");
-					Terminal* thisEmitter = findTerminalByComponent(transistorId, "transEmitter");
+	bool mapImage(const std::string& path)
+	{
+		auto mappedImage = std::make_shared<MappedFile>();
 
-					if (thisNotOut)
-					{
-						thisNotOut->state = false;
-						activeTerminals.push_back(thisNotOut);
-					}
+		if (!mappedImage->open(path))
+			return false;
 
-					if (thisEmitter)
-					{
-						thisEmitter->state = false;
-						activeTerminals.push_back(thisEmitter);
-					}
+		clear();
+		image = mappedImage;
+		return true;
+	}
+};
 
-					Terminal* thisNextTerminal = simulateTransistor(transistorId);
 
-					if (thisNextTerminal)
-					{
-						thisNextTerminal->state = true;
-						activeTerminals.push_back(thisNextTerminal);
-					}
-				}
+// Instruction level model of the SAP style computer whose microcode is in decodeMicroinstruction. It runs on the same
+// RAM as the gate level machine and spends one clock cycle per microstep before the MR step, so its cycle count
+// lines up with the clock.
+struct InstructionEmulator
+{
+	RamStore* ram = nullptr;
+	bool ramFixMode = true;
+	int pcMask = 0x0F;
+	int marMask = 0x0F;
+
+	uint8_t a = 0;
+	uint8_t b = 0;
+	uint8_t ir = 0;
+	uint8_t display = 0;
+	int pc = 0;
+	int mar = 0;
+	bool carry = false;
+	bool zero = false;
+	bool halted = false;
+	long long cycles = 0;
+	long long instructions = 0;
+
+	// Same result and flags as simulateALU for the current A and B.
+	uint8_t alu(bool subtract, bool& carryOut, bool& zeroOut) const
+	{
+		int result = subtract ? a - b : a + b;
 
-				transistorsToSimulate.clear();
+		if (result > 255)
+		{
+			result = 255;
+			carryOut = true;
+		}
+		else
+			carryOut = subtract && b == 1 && a != 0;
 
-				for (auto gatedLatchId : gatedLatchesToSimulate)
-				{
-					Terminal* thisDataOut = findTerminalByComponent(gatedLatchId, "gatedOut");
+		zeroOut = result == 0;
+		return uint8_t(result & 0xFF);
+	}
 
-					bool originalDataOutState = false;
-					if (thisDataOut->state)
-						originalDataOutState = true;
+	void step()
+	{
+		if (halted)
+			return;
 
-					simulateGatedLatch(gatedLatchId);
-					activeTerminals.push_back(thisDataOut);
-				}
+		// 000 MI, CO   001 RO, II, CE
+		mar = pc & marMask;
+		ir = ram->read(mar);
+		pc = (pc + 1) & pcMask;
+		cycles += 2;
 
-				gatedLatchesToSimulate.clear();				
+		int operand = ir & 0x0F;
 
-				for (auto terminal : activeTerminals)
-				{
-					for (auto& connection : connections)
-					{
-						if (connection.terminalA == terminal->id)
-						{
-							connection.state = terminal->state;
-							activeConnections.push_back(&connection);
-						}
-					}
-				}
+		switch (ir >> 4)
+		{
+		case 0x1: // LDA
+			mar = operand & marMask;
+			a = ram->read(mar);
+			cycles += 2;
+			break;
+
+		case 0x2: // ADD
+		case 0x3: // SUB
+		{
+			bool subtract = (ir >> 4) == 0x3;
+			bool sumCarry = false;
+			bool sumZero = false;
+
+			mar = operand & marMask;
+			b = ram->read(mar);
+			a = alu(subtract, sumCarry, sumZero);
+
+			// FI is still high after AI latches the sum, so the flags end up describing the new A and B.
+			alu(subtract, carry, zero);
+			cycles += 3;
+			break;
+		}
 
-				activeTerminals.clear();
+		case 0x4: // STA
+			mar = operand & marMask;
+			if (!ramFixMode || (mar > 0 && a))
+				ram->write(mar, a);
+			cycles += 2;
+			break;
+
+		case 0x5: // LDI
+			a = operand;
+			cycles += 1;
+			break;
+
+		case 0x6: // JMP
+			pc = operand & pcMask;
+			cycles += 1;
+			break;
+
+		case 0x7: // JC
+		case 0x8: // JZ
+			if ((ir >> 4) == 0x7 ? carry : zero)
+			{
+				pc = operand & pcMask;
+				cycles += 1;
+			}
+			break;
 
-				for (auto connection : activeConnections)
-				{
-					Terminal* currentTerminalB = findTerminal(connection->terminalB);
+		case 0xE: // OUT
+			display = a;
+			cycles += 1;
+			break;
 
-					if (std::find(newVisitedTerminalIds.begin(), newVisitedTerminalIds.end(), connection->terminalB) != newVisitedTerminalIds.end() && 1 == 2)					
-						newVisitedTerminalIds.erase(std::remove(newVisitedTerminalIds.begin(), newVisitedTerminalIds.end(), connection->terminalB), newVisitedTerminalIds.end());
-					else
-					{
-						newVisitedTerminalIds.push_back(connection->terminalB);
+		case 0xF: // HLT, the clock stops as soon as HT is decoded.
+			halted = true;
+			break;
 
-						if (currentTerminalB)
-						{
-							int oldTerminalBState = currentTerminalB->state;
-							currentTerminalB->state = connection->state;
-							int newTerminalBState = currentTerminalB->state;
+		default:  // NOP and unused opcodes go straight to MR.
+			break;
+		}
 
+		instructions++;
+	}
 
-							if (oldTerminalBState != newTerminalBState)
-							{
-								if (currentTerminalB->type == "buffer")
-									activeTerminals.push_back(currentTerminalB);
-								else if (currentTerminalB->type == "transBase" || currentTerminalB->type == "transCollector" || currentTerminalB->type == "transEmitter")
-									transistorsToSimulate.push_back(currentTerminalB->componentId);
-								else if (currentTerminalB->type == "gatedIn" || currentTerminalB->type == "gatedWriteEnable" || currentTerminalB->type == "gatedOut")
-									gatedLatchesToSimulate.push_back(currentTerminalB->componentId);
-								else if ("bus1" <= currentTerminalB->type && currentTerminalB->type <= "bus8")
-								{
-									for (auto& terminal : terminals)
-									{
-										if (terminal.type == currentTerminalB->type)
-										{
-											int oldState = terminal.state;
-											terminal.state = currentTerminalB->state;
-											activeTerminals.push_back(&terminal);
-											int newState = terminal.state;
+	void run(long long targetCycles)
+	{
+		while (!halted && cycles < targetCycles)
+			step();
+	}
+};
 
-											if (oldState != newState)
-											{
+// Flattened, index based copy of the terminals and connections. Every terminal maps to a node, terminals of the same
+// bus share one node, and each node is the OR of the propagating terminals wired into it plus its own logic.
+struct Netlist
+{
+	enum NodeKind
+	{
+		NODE_WIRE,      // Just the fan in
+		NODE_CONSTANT,  // Terminal 1 or folded by propagateConstants, value holds the state
+		NODE_EXTERNAL,  // Clock and behavioural outputs, written before every pass
+		NODE_LATCH,     // Stored bit, inputA is gatedIn and inputB is gatedWriteEnable
+		NODE_EMITTER,   // inputA is the base, inputB the collector
+		NODE_NOT_OUT,
+		NODE_NOT,       // Gate primitives from recognizeGates, operands in inputs
+		NODE_AND,
+		NODE_NAND,
+		NODE_XOR,
+	};
 
-											}
-										}
-									}
-								}
-							}	
-						}
-					}
+	struct Node
+	{
+		NodeKind kind = NODE_WIRE;
+		int inputA = -1;
+		int inputB = -1;
+		std::vector<int> inputs;
+		std::vector<int> fanIn;
+		uint8_t value = 1;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<int> terminalNodes;
+	std::vector<bool> hostNodes;  // Read back by the host after every pass
+
+	// Gate level rewrite of nodes, empty until recognizeGates runs. Only live nodes are evaluated every pass, the
+	// original nodes are still generated for drawing.
+	std::vector<Node> gates;
+	std::vector<bool> live;
+
+	// Filled by prepare for the interpreted evaluate.
+	std::vector<int> order;
+	std::vector<int> feedbackNodes;
+
+	// Reported by propagateConstants and pruneDeadLogic.
+	int foldedOn = 0;
+	int foldedOff = 0;
+	int deadNodes = 0;
+
+	static bool isCombinational(NodeKind kind)
+	{
+		return kind == NODE_WIRE || kind == NODE_EMITTER || kind == NODE_NOT_OUT || kind == NODE_NOT || kind == NODE_AND || kind == NODE_NAND || kind == NODE_XOR;
+	}
+
+	static std::vector<int> dependencies(const Node& node)
+	{
+		std::vector<int> result = node.fanIn;
+		result.insert(result.end(), node.inputs.begin(), node.inputs.end());
+
+		if (node.kind == NODE_EMITTER || node.kind == NODE_NOT_OUT)
+		{
+			result.push_back(node.inputA);
+			result.push_back(node.inputB);
+		}
+
+		result.erase(std::remove(result.begin(), result.end(), -1), result.end());
+		return result;
+	}
+
+	static std::string expression(const Node& node)
+	{
+		auto value = [](int input) { return input >= 0 ? "v[" + std::to_string(input) + "]" : std::string("0"); };
+		auto join = [&](const std::vector<int>& operands, std::string separator)
+		{
+			std::string result;
+			for (int operand : operands)
+				result += (result.size() ? separator : "") + value(operand);
+			return result;
+		};
+
+		std::string result;
+
+		if (node.kind == NODE_EMITTER)
+			result = "(" + value(node.inputA) + " & " + value(node.inputB) + ")";
+		else if (node.kind == NODE_NOT_OUT)
+			result = "((" + value(node.inputA) + " ^ 1) & " + value(node.inputB) + ")";
+		else if (node.kind == NODE_NOT)
+			result = "(" + value(node.inputs[0]) + " ^ 1)";
+		else if (node.kind == NODE_AND)
+			result = "(" + join(node.inputs, " & ") + ")";
+		else if (node.kind == NODE_NAND)
+			result = "((" + join(node.inputs, " & ") + ") ^ 1)";
+		else if (node.kind == NODE_XOR)
+			result = "(" + join(node.inputs, " ^ ") + ")";
+
+		for (int input : node.fanIn)
+			result += (result.size() ? " | " : "") + value(input);
+
+		return result.size() ? result : "0";
+	}
+
+	// Replaces transistor subgraphs with gates: series emitters become AND, a NOT on an AND becomes NAND, inverter
+	// chains cancel, AND(OR(a, b), NAND(a, b)) becomes XOR and pass through wires disappear. Nodes the host reads are
+	// kept as copies of whatever they ended up equal to.
+	void recognizeGates()
+	{
+		gates = nodes;
+		std::vector<int> alias(nodes.size());
+		std::map<int, int> inverters;
+
+		auto resolve = [&](int node)
+		{
+			while (node >= 0 && node < (int)alias.size() && alias[node] != node)
+				node = alias[node];
+			return node;
+		};
+
+		auto isConstant = [&](int node) { return node >= 0 && gates[node].kind == NODE_CONSTANT && gates[node].value; };
+
+		auto addGate = [&](NodeKind kind, std::vector<int> inputs)
+		{
+			Node gate;
+			gate.kind = kind;
+			gate.inputs = inputs;
+			gates.push_back(gate);
+			alias.push_back((int)alias.size());
+			hostNodes.push_back(false);
+			return (int)gates.size() - 1;
+		};
+
+		for (int node = 0; node < (int)nodes.size(); node++)
+			alias[node] = node;
+
+		// Transistors: emitter = base AND collector, notOut = NOT base AND collector.
+		for (int node = 0; node < (int)nodes.size(); node++)
+		{
+			Node& gate = gates[node];
+
+			if (gate.kind != NODE_EMITTER && gate.kind != NODE_NOT_OUT)
+				continue;
+
+			int base = gate.inputA;
+			int collector = gate.inputB;
+
+			// An unconnected base reads 0, so notOut just passes the collector through.
+			if (gate.kind == NODE_NOT_OUT && base < 0)
+			{
+				gate.kind = NODE_WIRE;
+				gate.inputA = -1;
+				gate.inputB = -1;
+				gate.fanIn.push_back(collector);
+				continue;
+			}
+
+			if (gate.kind == NODE_NOT_OUT)
+			{
+				if (!inverters.count(base))
+					inverters[base] = addGate(NODE_NOT, { base });
+
+				base = inverters[base];
+			}
+
+			Node& rewritten = gates[node];
+			rewritten.kind = NODE_AND;
+			rewritten.inputA = -1;
+			rewritten.inputB = -1;
+			rewritten.inputs = { base, collector };
+		}
+
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+
+			// Whatever a host node now stands for has to be kept as its own node.
+			std::vector<int> users(gates.size(), 0);
+			std::vector<bool> observed = hostNodes;
+			for (int node = 0; node < (int)gates.size(); node++)
+			{
+				if (hostNodes[node] && resolve(node) >= 0)
+					observed[resolve(node)] = true;
+
+				if (alias[node] != node)
+					continue;
+
+				for (int& input : gates[node].inputs)
+					input = resolve(input);
+
+				for (int& input : gates[node].fanIn)
+					input = resolve(input);
+
+				if (gates[node].kind == NODE_LATCH)
+				{
+					gates[node].inputA = resolve(gates[node].inputA);
+					gates[node].inputB = resolve(gates[node].inputB);
 				}
 
-				activeConnections.clear();
+				for (int input : dependencies(gates[node]))
+					users[input]++;
 
-				for (auto connection : connections)
+				if (gates[node].kind == NODE_LATCH)
 				{
-					if (connection.state)
+					if (gates[node].inputA >= 0)
+						users[gates[node].inputA]++;
+
+					if (gates[node].inputB >= 0)
+						users[gates[node].inputB]++;
+				}
+			}
+
+			auto isPlain = [&](int node, NodeKind kind) { return node >= 0 && alias[node] == node && gates[node].kind == kind && gates[node].fanIn.empty(); };
+			auto isPlainOr = [&](int node) { return node >= 0 && alias[node] == node && gates[node].kind == NODE_WIRE && gates[node].fanIn.size() == 2; };
+
+			for (int node = 0; node < (int)gates.size(); node++)
+			{
+				Node& gate = gates[node];
+
+				if (alias[node] != node || !isCombinational(gate.kind))
+					continue;
+
+				std::sort(gate.fanIn.begin(), gate.fanIn.end());
+				gate.fanIn.erase(std::unique(gate.fanIn.begin(), gate.fanIn.end()), gate.fanIn.end());
+				gate.fanIn.erase(std::remove(gate.fanIn.begin(), gate.fanIn.end(), -1), gate.fanIn.end());
+
+				// A node ORed with itself relaxes to the rest of its fan in.
+				gate.fanIn.erase(std::remove(gate.fanIn.begin(), gate.fanIn.end(), node), gate.fanIn.end());
+
+				if (gate.kind == NODE_AND)
+				{
+					// Constant inputs drop out, a zero input turns the whole gate off.
+					if (std::find(gate.inputs.begin(), gate.inputs.end(), -1) != gate.inputs.end())
 					{
-						for (auto& terminal : terminals)
+						gate.kind = NODE_WIRE;
+						gate.inputs.clear();
+						changed = true;
+					}
+					else
+					{
+						size_t oldSize = gate.inputs.size();
+						auto constant = std::find_if(gate.inputs.begin(), gate.inputs.end(), isConstant);
+						int constantNode = constant != gate.inputs.end() ? *constant : -1;
+
+						gate.inputs.erase(std::remove_if(gate.inputs.begin(), gate.inputs.end(), isConstant), gate.inputs.end());
+
+						if (gate.inputs.empty())
+							gate.inputs.push_back(constantNode);
+						std::sort(gate.inputs.begin(), gate.inputs.end());
+						gate.inputs.erase(std::unique(gate.inputs.begin(), gate.inputs.end()), gate.inputs.end());
+
+						// Series transistors: an AND feeding only this AND is merged into it.
+						std::vector<int> merged;
+						for (int input : gate.inputs)
 						{
-							if (terminal.id == connection.terminalB)
+							if (input != node && users[input] == 1 && !observed[input] && isPlain(input, NODE_AND))
 							{
-								terminal.state = true;
+								merged.insert(merged.end(), gates[input].inputs.begin(), gates[input].inputs.end());
+								alias[input] = -1;
+							}
+							else
+								merged.push_back(input);
+						}
+
+						if (merged.size() != gate.inputs.size() || oldSize != gate.inputs.size())
+							changed = true;
+
+						gate.inputs = merged;
+
+						if (gate.inputs.size() == 1)
+						{
+							gate.fanIn.push_back(gate.inputs[0]);
+							gate.kind = NODE_WIRE;
+							gate.inputs.clear();
+							changed = true;
+						}
+						else if (gate.inputs.size() == 2 && gate.fanIn.empty())
+						{
+							// XOR is (a OR b) AND NOT (a AND b).
+							int orNode = isPlainOr(gate.inputs[0]) ? gate.inputs[0] : gate.inputs[1];
+							int nandNode = orNode == gate.inputs[0] ? gate.inputs[1] : gate.inputs[0];
+							std::vector<int> operands;
+
+							std::vector<int> orOperands;
+
+							if (isPlainOr(orNode) && isPlain(nandNode, NODE_NAND))
+							{
+								operands = gates[nandNode].inputs;
+								orOperands = gates[orNode].fanIn;
+								std::sort(operands.begin(), operands.end());
+								std::sort(orOperands.begin(), orOperands.end());
+							}
+
+							if (operands.size() == 2 && operands == orOperands)
+							{
+								gate.kind = NODE_XOR;
+								gate.inputs = operands;
+								changed = true;
 							}
 						}
 					}
 				}
 
-				// Simulate dynamic components
-				simulateALU();
-				simulateCounter();
-				simulateMicrocounter();
-				simulateIR();
-				simulateDecoder();
-				simulateFlagsReg();
-				simulateDisplay();
-				simulateRAM();
-				updateSourceConnections();
-			}
+				if (gate.kind == NODE_NOT && gate.fanIn.empty())
+				{
+					int input = gate.inputs[0];
 
-			std::vector<int> newTerminalsState = {};
-			for (auto terminal : terminals)
-			{
-				newTerminalsState.push_back(terminal.state);
-			}
+					if (isConstant(input))
+					{
+						gate.kind = NODE_WIRE;
+						gate.inputs.clear();
+						changed = true;
+					}
+					else if (isPlain(input, NODE_NOT) && resolve(gates[input].inputs[0]) != node)
+					{
+						alias[node] = gates[input].inputs[0];
+						changed = true;
+					}
+					else if (users[input] == 1 && !observed[input] && (isPlain(input, NODE_AND) || isPlain(input, NODE_NAND)))
+					{
+						gate.kind = gates[input].kind == NODE_AND ? NODE_NAND : NODE_AND;
+						gate.inputs = gates[input].inputs;
+						alias[input] = -1;
+						changed = true;
+					}
+				}
 
-			bool somethingChanged = false;
-			for (int i = 0; i < newTerminalsState.size(); i++)
-			{
-				if (previousTerminalsState[i] != newTerminalsState[i])
+				// Buffers and other single input wires are just another name for their driver.
+				if (alias[node] == node && gate.kind == NODE_WIRE && gate.fanIn.size() <= 1 && (gate.fanIn.empty() || resolve(gate.fanIn[0]) != node))
 				{
-					somethingChanged = true;
-					break;
+					alias[node] = gate.fanIn.size() ? gate.fanIn[0] : -1;
+					changed = true;
 				}
 			}
+		}
 
-			if (!somethingChanged)
-				updateSimulation = false;
+		// Host nodes that turned into another name for some node still get their value, as a plain copy.
+		for (int node = 0; node < (int)gates.size(); node++)
+		{
+			if (!hostNodes[node] || alias[node] == node)
+				continue;
+
+			int source = resolve(node);
+			gates[node] = Node();
+
+			if (source >= 0)
+				gates[node].fanIn.push_back(source);
+
+			alias[node] = node;
 		}
 
-		//---------------------
+		pruneDeadLogic();
+	}
+
+	// Folds nodes that can only ever hold one value: whatever terminal 1 drives, and whatever an undriven collector or
+	// an unconnected wire leaves off. References to nodes that are always off become -1, which every pass reads as off.
+	void propagateConstants()
+	{
+		std::vector<int> known(nodes.size(), -1);
 
-		if (GetMouse(0).bReleased)
+		for (int node = 0; node < (int)nodes.size(); node++)
+			if (nodes[node].kind == NODE_CONSTANT)
+				known[node] = nodes[node].value;
+
+		auto value = [&](int input) { return input >= 0 ? known[input] : 0; };
+
+		bool changed = true;
+		while (changed)
 		{
-			if (!placingModule)
+			changed = false;
+
+			for (int node = 0; node < (int)nodes.size(); node++)
 			{
-				components.push_back({ lastComponentId, inventoryComponents[activeInventoryComponent], GetWorldMouse() });
+				const Node& current = nodes[node];
 
-				if (inventoryComponents[activeInventoryComponent] == "TRANSISTOR")
+				if (known[node] >= 0 || !isCombinational(current.kind))
+					continue;
+
+				bool on = false;
+				bool unknown = false;
+
+				if (current.kind == NODE_EMITTER || current.kind == NODE_NOT_OUT)
 				{
-					terminals.push_back({ lastTerminalId, GetWorldMouse() + olc::vi2d(25, -25), false, "transCollector", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, GetWorldMouse() + olc::vi2d(-25, 0), false, "transBase", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, GetWorldMouse() + olc::vi2d(25, 25), false, "transEmitter", lastComponentId });
-					lastTerminalId++;
+					int base = value(current.inputA);
+					int collector = value(current.inputB);
+
+					if (current.kind == NODE_NOT_OUT && base >= 0)
+						base ^= 1;
+
+					on = base == 1 && collector == 1;
+					unknown = base && collector && !on;
 				}
 
-				if (inventoryComponents[activeInventoryComponent] == "GATED LATCH")
+				for (int input : current.fanIn)
 				{
-					terminals.push_back({ lastTerminalId, GetWorldMouse() + olc::vi2d(-25, -25), false, "gatedIn", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, GetWorldMouse() + olc::vi2d(-25, 25), false, "gatedWriteEnable", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, GetWorldMouse() + olc::vi2d(25, 0), false, "gatedOut", lastComponentId });
-					lastTerminalId++;
+					on |= value(input) == 1;
+					unknown |= value(input) < 0;
 				}
 
-				if (inventoryComponents[activeInventoryComponent] == "ALU")
+				if (on || !unknown)
 				{
-					float margin = 27.3;
-					int width = 300;
-					olc::vf2d worldMouse = GetWorldMouse();
+					known[node] = on;
+					changed = true;
+				}
+			}
+		}
 
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(width, width / 2), false, "aluSub", lastComponentId });
-					lastTerminalId++;
+		foldedOn = 0;
+		foldedOff = 0;
 
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(width, width / 6), false, "aluZeroFlagOut", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(width, width / 4), false, "aluCarryFlagOut", lastComponentId });
-					lastTerminalId++;
+		for (int node = 0; node < (int)nodes.size(); node++)
+		{
+			if (known[node] < 0 || !isCombinational(nodes[node].kind))
+				continue;
 
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(margin * 2 + 0 * margin, 0), false, "aluInA1", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(margin * 2 + 1 * margin, 0), false, "aluInA2", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(margin * 2 + 2 * margin, 0), false, "aluInA3", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(margin * 2 + 3 * margin, 0), false, "aluInA4", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(margin * 2 + 4 * margin, 0), false, "aluInA5", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(margin * 2 + 5 * margin, 0), false, "aluInA6", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(margin * 2 + 6 * margin, 0), false, "aluInA7", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(margin * 2 + 7 * margin, 0), false, "aluInA8", lastComponentId });
-					lastTerminalId++;
+			nodes[node] = Node();
+			nodes[node].kind = NODE_CONSTANT;
+			nodes[node].value = known[node];
+			(known[node] ? foldedOn : foldedOff)++;
+		}
 
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(margin * 2 + 0 * margin, margin * 3 + margin * 8), false, "aluInB1", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(margin * 2 + 1 * margin, margin * 3 + margin * 8), false, "aluInB2", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(margin * 2 + 2 * margin, margin * 3 + margin * 8), false, "aluInB3", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(margin * 2 + 3 * margin, margin * 3 + margin * 8), false, "aluInB4", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(margin * 2 + 4 * margin, margin * 3 + margin * 8), false, "aluInB5", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(margin * 2 + 5 * margin, margin * 3 + margin * 8), false, "aluInB6", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(margin * 2 + 6 * margin, margin * 3 + margin * 8), false, "aluInB7", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(margin * 2 + 7 * margin, margin * 3 + margin * 8), false, "aluInB8", lastComponentId });
-					lastTerminalId++;
+		auto isOff = [&](int input) { return input >= 0 && known[input] == 0; };
+		auto isOn = [&](int input) { return input >= 0 && known[input] == 1; };
 
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(0, margin * 2 + 0 * margin), false, "aluOut1", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(0, margin * 2 + 1 * margin), false, "aluOut2", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(0, margin * 2 + 2 * margin), false, "aluOut3", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(0, margin * 2 + 3 * margin), false, "aluOut4", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(0, margin * 2 + 4 * margin), false, "aluOut5", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(0, margin * 2 + 5 * margin), false, "aluOut6", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(0, margin * 2 + 6 * margin), false, "aluOut7", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(0, margin * 2 + 7 * margin), false, "aluOut8", lastComponentId });
-					lastTerminalId++;
-				}
+		for (auto& node : nodes)
+		{
+			if (isOff(node.inputA))
+				node.inputA = -1;
 
-				if (inventoryComponents[activeInventoryComponent] == "RAM")
-				{
-					float scale = pz.GetScale().x;
-					int margin = 20 * scale;
-					int ramHeight = 415 * scale;
-					int ramWidth = 215 * scale;
-					olc::vf2d worldMouse = GetWorldMouse();
+			if (isOff(node.inputB))
+				node.inputB = -1;
 
-					// Input Terminals
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 0 * margin, 0), false, "ramIn1", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 1.25 * margin, 0), false, "ramIn2", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 2.5 * margin, 0), false, "ramIn3", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 3.75 * margin, 0), false, "ramIn4", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 5 * margin, 0), false, "ramIn5", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 6.25 * margin, 0), false, "ramIn6", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 7.5 * margin, 0), false, "ramIn7", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 8.75 * margin, 0), false, "ramIn8", lastComponentId });
-					lastTerminalId++;
+			node.fanIn.erase(std::remove_if(node.fanIn.begin(), node.fanIn.end(), isOff), node.fanIn.end());
 
-					// Output Terminals
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 0 * margin, ramHeight), false, "ramOut1", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 1.25 * margin, ramHeight), false, "ramOut2", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 2.5 * margin, ramHeight), false, "ramOut3", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 3.75 * margin, ramHeight), false, "ramOut4", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 5 * margin, ramHeight), false, "ramOut5", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 6.25 * margin, ramHeight), false, "ramOut6", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 7.5 * margin, ramHeight), false, "ramOut7", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 8.75 * margin, ramHeight), false, "ramOut8", lastComponentId });
-					lastTerminalId++;
+			// A transistor with one side stuck on is a wire or an inverter.
+			if (node.kind == NODE_EMITTER && (isOn(node.inputA) || isOn(node.inputB)))
+			{
+				node.fanIn.push_back(isOn(node.inputA) ? node.inputB : node.inputA);
+				node.kind = NODE_WIRE;
+				node.inputA = -1;
+				node.inputB = -1;
+			}
+			else if (node.kind == NODE_NOT_OUT && node.inputA < 0)
+			{
+				node.fanIn.push_back(node.inputB);
+				node.kind = NODE_WIRE;
+				node.inputB = -1;
+			}
+			else if (node.kind == NODE_NOT_OUT && isOn(node.inputB))
+			{
+				node.inputs = { node.inputA };
+				node.kind = NODE_NOT;
+				node.inputA = -1;
+				node.inputB = -1;
+			}
+		}
+	}
 
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(0, ramHeight / 2 + 20), false, "ramWriteEnable", lastComponentId });
-					lastTerminalId++;
+	// Walks back from what the host and the latches read. Nothing else reaches an observable terminal, so it is only
+	// evaluated by the visual pass.
+	void pruneDeadLogic()
+	{
+		const std::vector<Node>& definitions = gates.size() ? gates : nodes;
+		live.assign(definitions.size(), false);
+		std::vector<int> pending;
 
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(ramWidth, ramHeight / 2 - 60), false, "ramAddressIn4", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(ramWidth, ramHeight / 2 - 20), false, "ramAddressIn3", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(ramWidth, ramHeight / 2 + 20), false, "ramAddressIn2", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(ramWidth, ramHeight / 2 + 60), false, "ramAddressIn1", lastComponentId });
-					lastTerminalId++;
-				}
+		for (int node = 0; node < (int)definitions.size(); node++)
+		{
+			if (hostNodes[node])
+				pending.push_back(node);
 
-				if (inventoryComponents[activeInventoryComponent] == "COUNTER")
-				{
-					float scale = pz.GetScale().x;
-					int counterWidth = 120 * scale;
-					int counterHeight = 50 * scale;
-					float bitPadding = 25 * scale;
-					olc::vf2d worldMouse = GetWorldMouse();
+			if (definitions[node].kind == NODE_LATCH)
+			{
+				pending.push_back(definitions[node].inputA);
+				pending.push_back(definitions[node].inputB);
+			}
+		}
 
-					// Counter In
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding - 4, 0), false, "counterIn4", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 2 - 4, 0), false, "counterIn3", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 3 - 4, 0), false, "counterIn2", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 4 - 4, 0), false, "counterIn1", lastComponentId });
-					lastTerminalId++;
+		while (pending.size())
+		{
+			int node = pending.back();
+			pending.pop_back();
 
-					// Counter Out
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding - 4, counterHeight), false, "counterOut4", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 2 - 4, counterHeight), false, "counterOut3", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 3 - 4, counterHeight), false, "counterOut2", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 4 - 4, counterHeight), false, "counterOut1", lastComponentId });
-					lastTerminalId++;
+			if (node < 0 || live[node])
+				continue;
 
-					// Counter Clock
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(0, 0 + bitPadding / 3), false, "counterClock", lastComponentId });
-					lastTerminalId++;
+			live[node] = true;
 
-					// Jump (Counter Write Enable)
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(0, counterHeight / 2), false, "counterWriteEnable", lastComponentId });
-					lastTerminalId++;
+			for (int input : dependencies(definitions[node]))
+				pending.push_back(input);
+		}
 
-					// Count Enable (increment)
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(0, counterHeight - bitPadding / 3), false, "counterCountEnable", lastComponentId });
-					lastTerminalId++;
-				}
+		deadNodes = 0;
+		for (int node = 0; node < (int)definitions.size(); node++)
+			if (isCombinational(definitions[node].kind) && !live[node])
+				deadNodes++;
+	}
 
-				if (inventoryComponents[activeInventoryComponent] == "MICROCOUNTER")
-				{
-					float scale = pz.GetScale().x;
-					int counterWidth = 120 * scale;
-					int counterHeight = 50 * scale;
-					float bitPadding = 25 * scale;
-					olc::vf2d worldMouse = GetWorldMouse();
+	// Nodes assigned in every settle pass, optionally only those of one kind.
+	int countEvaluated(int kind = -1) const
+	{
+		int count = 0;
+		const std::vector<Node>& definitions = gates.size() ? gates : nodes;
 
-					// Reset
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(0, counterHeight / 2), false, "microcounterReset", lastComponentId });
-					lastTerminalId++;
+		for (int node = 0; node < (int)definitions.size(); node++)
+			if (isCombinational(definitions[node].kind) && (live.empty() || live[node]) && (kind < 0 || definitions[node].kind == kind))
+				count++;
 
-					// Counter In
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 2 - 29, 0), false, "microcounterIn3", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 3 - 29, 0), false, "microcounterIn2", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 4 - 29, 0), false, "microcounterIn1", lastComponentId });
-					lastTerminalId++;
+		return count;
+	}
 
-					// Counter Out
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 2 - 29, counterHeight), false, "microcounterOut3", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 3 - 29, counterHeight), false, "microcounterOut2", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 4 - 29, counterHeight), false, "microcounterOut1", lastComponentId });
-					lastTerminalId++;
-				}
+	// Topological order of the evaluated combinational nodes. Nodes that sit on or after a feedback loop are left out of
+	// order and returned in feedbackNodes instead.
+	static void sortNodes(const std::vector<Node>& definitions, const std::vector<bool>& evaluated, std::vector<int>& order, std::vector<int>& feedbackNodes)
+	{
+		order.clear();
+		feedbackNodes.clear();
+		std::vector<int> pendingInputs(definitions.size(), 0);
+		std::vector<std::vector<int>> fanOut(definitions.size());
 
-				if (inventoryComponents[activeInventoryComponent] == "IR")
+		auto included = [&](int node) { return isCombinational(definitions[node].kind) && (evaluated.empty() || evaluated[node]); };
+
+		for (int node = 0; node < (int)definitions.size(); node++)
+		{
+			if (!included(node))
+				continue;
+
+			for (int input : dependencies(definitions[node]))
+			{
+				if (included(input))
 				{
-					float scale = pz.GetScale().x;
-					int counterWidth = 240 * scale;
-					int counterHeight = 50 * scale;
-					float bitPadding = 25 * scale;
-					float xOffset = -6 * scale;
-					olc::vf2d worldMouse = GetWorldMouse();
+					pendingInputs[node]++;
+					fanOut[input].push_back(node);
+				}
+			}
+		}
 
-					// IR In
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding - xOffset, 0), false, "IRIn8", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 2 - xOffset, 0), false, "IRIn7", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 3 - xOffset, 0), false, "IRIn6", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 4 - xOffset, 0), false, "IRIn5", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 5 - xOffset, 0), false, "IRIn4", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 6 - xOffset, 0), false, "IRIn3", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 7 - xOffset, 0), false, "IRIn2", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 8 - xOffset, 0), false, "IRIn1", lastComponentId });
-					lastTerminalId++;
+		for (int node = 0; node < (int)definitions.size(); node++)
+			if (included(node) && !pendingInputs[node])
+				order.push_back(node);
 
-					// IR Decode Out
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding - xOffset, counterHeight), false, "IRDecodeOut8", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 2 - xOffset, counterHeight), false, "IRDecodeOut7", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 3 - xOffset, counterHeight), false, "IRDecodeOut6", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 4 - xOffset, counterHeight), false, "IRDecodeOut5", lastComponentId });
-					lastTerminalId++;
+		for (int i = 0; i < (int)order.size(); i++)
+			for (int next : fanOut[order[i]])
+				if (--pendingInputs[next] == 0)
+					order.push_back(next);
 
-					// IR Out
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 5- xOffset, counterHeight), false, "IROut4", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 6 - xOffset, counterHeight), false, "IROut3", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 7 - xOffset, counterHeight), false, "IROut2", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 8 - xOffset, counterHeight), false, "IROut1", lastComponentId });
-					lastTerminalId++;
+		for (int node = 0; node < (int)definitions.size(); node++)
+			if (included(node) && pendingInputs[node])
+				feedbackNodes.push_back(node);
+	}
 
-					// IR Write Enable
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(0, counterHeight / 2), false, "IRWriteEnable", lastComponentId });
-					lastTerminalId++;
+	// Straight line C++ for one pass of the wire network. Feedback nodes are relaxed from zero until they stop
+	// changing, the same starting point the interpreter resets to.
+	static void generateSettle(std::stringstream& source, std::string name, const std::vector<Node>& definitions, const std::vector<bool>& evaluated)
+	{
+		std::vector<int> order;
+		std::vector<int> feedbackNodes;
+		sortNodes(definitions, evaluated, order, feedbackNodes);
 
-					
-				}
+		source << "static void " << name << "(uint8_t* v)\n{\n";
 
-				if (inventoryComponents[activeInventoryComponent] == "DECODER")
-				{
-					float scale = pz.GetScale().x;
-					int width = 300 * scale;
-					int height = 60 * scale;
-					float bitPadding = 25 * scale;
-					float topBitPadding = 50 * scale;
-					float xOffset = 25 * scale;
-					olc::vf2d worldMouse = GetWorldMouse();
+		for (int node : order)
+			source << "\tv[" << node << "] = " << expression(definitions[node]) << ";\n";
 
-					// Decoder In
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(topBitPadding - xOffset, 0), false, "decoderIn1", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(topBitPadding * 2 - xOffset, 0), false, "decoderIn2", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(topBitPadding * 3 - xOffset, 0), false, "decoderIn3", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(topBitPadding * 4 - xOffset, 0), false, "decoderIn4", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(topBitPadding * 5 - xOffset, 0), false, "decoderIn5", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(topBitPadding * 6 - xOffset, 0), false, "decoderIn6", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(topBitPadding * 7 - xOffset, 0), false, "decoderIn7", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(topBitPadding * 8 - xOffset, 0), false, "decoderIn8", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(topBitPadding * 9 - xOffset, 0), false, "decoderIn9", lastComponentId });
-					lastTerminalId++;
+		if (feedbackNodes.size())
+		{
+			for (int node : feedbackNodes)
+				source << "\tv[" << node << "] = 0;\n";
 
-					// Decoder Out
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding, height), false, "decoderOut1", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 2, height), false, "decoderOut2", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 3, height), false, "decoderOut3", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 4, height), false, "decoderOut4", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 5, height), false, "decoderOut5", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 6, height), false, "decoderOut6", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 7, height), false, "decoderOut7", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 8, height), false, "decoderOut8", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 9, height), false, "decoderOut9", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 10, height), false, "decoderOut10", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 11, height), false, "decoderOut11", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 12, height), false, "decoderOut12", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 13, height), false, "decoderOut13", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 14, height), false, "decoderOut14", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 15, height), false, "decoderOut15", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 16, height), false, "decoderOut16", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 17, height), false, "decoderOut17", lastComponentId });
-					lastTerminalId++;
-				}
+			source << "\tfor (int pass = 0; pass < 64; pass++)\n\t{\n\t\tuint8_t changed = 0;\n\t\tuint8_t next;\n";
 
-				if (inventoryComponents[activeInventoryComponent] == "FLAGSREG")
-				{
-					float scale = pz.GetScale().x;
-					int width = 75 * scale;
-					int height = 60 * scale;
-					float bitPadding = 25 * scale;
-					float xOffset = 0 * scale;
-					olc::vf2d worldMouse = GetWorldMouse();
+			for (int node : feedbackNodes)
+				source << "\t\tnext = " << expression(definitions[node]) << "; changed |= next ^ v[" << node << "]; v[" << node << "] = next;\n";
 
-					// Flags Write Enable
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(width, height / 2), false, "flagsRegWriteEnable", lastComponentId });
-					lastTerminalId++;
+			source << "\t\tif (!changed)\n\t\t\tbreak;\n\t}\n";
+		}
 
-					// Flags Reg In
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding - xOffset, 0), false, "flagsRegIn1", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 2 - xOffset, 0), false, "flagsRegIn2", lastComponentId });
-					lastTerminalId++;
+		source << "}\n\n";
+	}
 
-					// Flags Reg Out
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding - xOffset, height), false, "flagsRegOut1", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 2 - xOffset, height), false, "flagsRegOut2", lastComponentId });
-					lastTerminalId++;
-				}
+	static uint8_t evaluateNode(const Node& node, const std::vector<uint8_t>& values)
+	{
+		auto value = [&](int input) { return input >= 0 ? values[input] : (uint8_t)0; };
+		uint8_t result = 0;
+
+		if (node.kind == NODE_EMITTER)
+			result = value(node.inputA) & value(node.inputB);
+		else if (node.kind == NODE_NOT_OUT)
+			result = (value(node.inputA) ^ 1) & value(node.inputB);
+		else if (node.kind == NODE_NOT)
+			result = value(node.inputs[0]) ^ 1;
+		else if (node.kind == NODE_AND || node.kind == NODE_NAND)
+		{
+			result = 1;
+			for (int input : node.inputs)
+				result &= value(input);
 
-				if (inventoryComponents[activeInventoryComponent] == "DISPLAY")
-				{
-					float scale = pz.GetScale().x;
-					int width = 405 * scale;
-					int height = 180 * scale;
-					float bitPadding = 17 * scale;
-					olc::vf2d worldMouse = GetWorldMouse();
+			if (node.kind == NODE_NAND)
+				result ^= 1;
+		}
+		else if (node.kind == NODE_XOR)
+			for (int input : node.inputs)
+				result ^= value(input);
 
-					// Display In
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding, 0), false, "displayIn8", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 2, 0), false, "displayIn7", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 3, 0), false, "displayIn6", lastComponentId });
-					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 4, 0), false, "displayIn5", lastComponentId });
+		for (int input : node.fanIn)
+			result |= value(input);
+
+		return result;
+	}
+
+	// Evaluation order for evaluate, computed once per netlist.
+	void prepare()
+	{
+		sortNodes(nodes, {}, order, feedbackNodes);
+	}
+
+	void settleValues(std::vector<uint8_t>& values) const
+	{
+		for (int node : order)
+			values[node] = evaluateNode(nodes[node], values);
+
+		for (int node : feedbackNodes)
+			values[node] = 0;
+
+		for (int pass = 0; pass < 64 && feedbackNodes.size(); pass++)
+		{
+			uint8_t changed = 0;
+
+			for (int node : feedbackNodes)
+			{
+				uint8_t next = evaluateNode(nodes[node], values);
+				changed |= next ^ values[node];
+				values[node] = next;
+			}
+
+			if (!changed)
+				break;
+		}
+	}
+
+	// Interpreted counterpart of the generated passes, used for netlists too small to be worth compiling such as
+	// module definitions. External nodes are written by the caller beforehand.
+	void evaluate(std::vector<uint8_t>& values, bool risingEdge) const
+	{
+		settleValues(values);
+
+		if (!risingEdge)
+			return;
+
+		std::vector<std::pair<int, uint8_t>> captured;
+		for (int node = 0; node < (int)nodes.size(); node++)
+			if (nodes[node].kind == NODE_LATCH && nodes[node].inputB >= 0)
+				captured.push_back({ node, values[nodes[node].inputB] ? (nodes[node].inputA >= 0 ? values[nodes[node].inputA] : (uint8_t)0) : values[node] });
+
+		for (auto& latch : captured)
+			values[latch.first] = latch.second;
+
+		settleValues(values);
+	}
+
+	std::string generateSource() const
+	{
+		const std::vector<Node>& definitions = gates.size() ? gates : nodes;
+
+		std::stringstream source;
+		source << "// Generated by viscom from a " << nodes.size() << " node netlist, " << countEvaluated() << " evaluated per pass.\n";
+		source << "#include <cstdint>\n\n";
+		source << "#if defined(_WIN32)\n#define VISCOM_EXPORT extern \"C\" __declspec(dllexport)\n#else\n#define VISCOM_EXPORT extern \"C\"\n#endif\n\n";
+
+		generateSettle(source, "settle", definitions, live);
+		generateSettle(source, "visual", nodes, {});
+
+		source << "VISCOM_EXPORT void viscom_falling_edge(uint8_t* v)\n{\n\tsettle(v);\n}\n\n";
+		source << "VISCOM_EXPORT void viscom_settle(uint8_t* v)\n{\n\tsettle(v);\n}\n\n";
+		source << "VISCOM_EXPORT void viscom_visual(uint8_t* v)\n{\n\tvisual(v);\n}\n\n";
+		source << "VISCOM_EXPORT void viscom_rising_edge(uint8_t* v)\n{\n\tsettle(v);\n";
+
+		// Every latch samples the settled network before any of them changes.
+		std::vector<int> latches;
+		for (int node = 0; node < (int)definitions.size(); node++)
+			if (definitions[node].kind == NODE_LATCH && definitions[node].inputB >= 0)
+				latches.push_back(node);
+
+		for (int i = 0; i < (int)latches.size(); i++)
+		{
+			const Node& latch = definitions[latches[i]];
+			source << "\tuint8_t latch" << i << " = v[" << latch.inputB << "] ? " << (latch.inputA >= 0 ? "v[" + std::to_string(latch.inputA) + "]" : std::string("0")) << " : v[" << latches[i] << "];\n";
+		}
+
+		for (int i = 0; i < (int)latches.size(); i++)
+			source << "\tv[" << latches[i] << "] = latch" << i << ";\n";
+
+		source << "\tsettle(v);\n}\n";
+		return source.str();
+	}
+};
+
+// A generated netlist compiled by the system compiler into a shared library and loaded in place. Libraries are kept in
+// cache/ under the FNV-1a hash of their source, so an unchanged circuit is only ever compiled once.
+struct CompiledNetlist
+{
+	typedef void (*PassFunction)(uint8_t*);
+
+	PassFunction risingEdge = nullptr;
+	PassFunction fallingEdge = nullptr;
+	PassFunction settle = nullptr;
+	PassFunction visual = nullptr;
+	std::vector<uint8_t> values;
+#if defined(_WIN32)
+	HMODULE library = NULL;
+#else
+	void* library = nullptr;
+#endif
+
+	CompiledNetlist() = default;
+	CompiledNetlist(const CompiledNetlist&) = delete;
+	CompiledNetlist& operator=(const CompiledNetlist&) = delete;
+
+	~CompiledNetlist()
+	{
+		close();
+	}
+
+	bool ready() const
+	{
+		return risingEdge && fallingEdge && settle && visual;
+	}
+
+	bool load(const Netlist& netlist, std::string& error)
+	{
+		close();
+
+		std::string source = netlist.generateSource();
+		std::string basePath = "cache/netlist_" + contentHash(source.data(), source.size());
+#if defined(_WIN32)
+		std::string libraryPath = basePath + ".dll";
+		CreateDirectoryA("cache", NULL);
+#else
+		std::string libraryPath = basePath + ".so";
+		mkdir("cache", 0755);
+#endif
+
+		if (!std::ifstream(libraryPath).good())
+		{
+			std::ofstream sourceFile(basePath + ".cpp");
+			sourceFile << source;
+			sourceFile.close();
+
+			if (!sourceFile)
+			{
+				error = "could not write " + basePath + ".cpp";
+				return false;
+			}
+
+			// Build under a temporary name so a failed or interrupted compile never leaves a bad library in the cache.
+#if defined(_WIN32)
+			std::string command = "cl /nologo /O2 /LD \"" + basePath + ".cpp\" /Fe\"" + basePath + ".tmp.dll\" /Fo\"" + basePath + ".obj\" > NUL";
+			std::string temporaryPath = basePath + ".tmp.dll";
+#else
+			std::string command = "c++ -O1 -shared -fPIC -o \"" + basePath + ".tmp.so\" \"" + basePath + ".cpp\"";
+			std::string temporaryPath = basePath + ".tmp.so";
+#endif
+
+			if (std::system(command.c_str()) != 0 || std::rename(temporaryPath.c_str(), libraryPath.c_str()) != 0)
+			{
+				error = "compiler failed: " + command;
+				return false;
+			}
+		}
+
+#if defined(_WIN32)
+		library = LoadLibraryA(libraryPath.c_str());
+
+		if (library)
+		{
+			risingEdge = (PassFunction)GetProcAddress(library, "viscom_rising_edge");
+			fallingEdge = (PassFunction)GetProcAddress(library, "viscom_falling_edge");
+			settle = (PassFunction)GetProcAddress(library, "viscom_settle");
+			visual = (PassFunction)GetProcAddress(library, "viscom_visual");
+		}
+#else
+		library = dlopen(libraryPath.c_str(), RTLD_NOW | RTLD_LOCAL);
+
+		if (library)
+		{
+			risingEdge = (PassFunction)dlsym(library, "viscom_rising_edge");
+			fallingEdge = (PassFunction)dlsym(library, "viscom_falling_edge");
+			settle = (PassFunction)dlsym(library, "viscom_settle");
+			visual = (PassFunction)dlsym(library, "viscom_visual");
+		}
+#endif
+
+		if (!ready())
+		{
+			error = "could not load " + libraryPath;
+			close();
+			return false;
+		}
+
+		values.assign(std::max(netlist.nodes.size(), netlist.gates.size()), 0);
+		return true;
+	}
+
+	void close()
+	{
+#if defined(_WIN32)
+		if (library)
+			FreeLibrary(library);
+
+		library = NULL;
+#else
+		if (library)
+			dlclose(library);
+
+		library = nullptr;
+#endif
+		risingEdge = nullptr;
+		fallingEdge = nullptr;
+		settle = nullptr;
+		visual = nullptr;
+		values.clear();
+	}
+};
+
+// Binary body of a save container. A header, fixed width records of little endian 32 bit fields, the type strings the
+// records index into, and per terminal record the connections it drives (offsets then connection indices). The string
+// table is padded so everything after it stays 4 byte aligned.
+struct BinarySave
+{
+	static const uint32_t magic = 0x42435356;  // "VSCB"
+	static const uint32_t version = 1;
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		int32_t lastTerminalId;
+		int32_t lastConnectionId;
+		int32_t lastComponentId;
+		uint32_t componentCount;
+		uint32_t terminalCount;
+		uint32_t connectionCount;
+		uint32_t stringCount;
+		uint32_t stringBytes;
+		uint32_t adjacencyCount;
+	};
+
+	struct ComponentRecord
+	{
+		int32_t id;
+		uint32_t type;
+		int32_t x;
+		int32_t y;
+		int32_t width;
+	};
+
+	struct TerminalRecord
+	{
+		int32_t id;
+		int32_t x;
+		int32_t y;
+		uint32_t type;
+		int32_t componentId;
+	};
+
+	struct ConnectionRecord
+	{
+		int32_t id;
+		int32_t terminalA;
+		int32_t terminalB;
+		int32_t terminalAX;
+		int32_t terminalAY;
+		int32_t terminalBX;
+		int32_t terminalBY;
+		int32_t notOutTerminal;
+	};
+};
+
+// The text lines at the start of a saves/<name>.vsave container, readable without touching the body that follows.
+// The body starts at the first multiple of 8 after the blank line that ends the manifest.
+struct SaveManifest
+{
+	std::string name;
+	long long created = 0;
+	int components = 0;
+	int terminals = 0;
+	int connections = 0;
+	std::string hash;     // contentHash of the body
+	size_t bodySize = 0;
+	size_t bodyOffset = 0;
+	int journal = 0;      // First journal generation not already in the body, see Design::journalPath
+
+	static constexpr const char* signature = "viscom save 1";
+
+	std::string text() const
+	{
+		std::stringstream manifest;
+		manifest << signature << "\n";
+		manifest << "name=" << name << "\n";
+		manifest << "created=" << created << "\n";
+		manifest << "components=" << components << "\n";
+		manifest << "terminals=" << terminals << "\n";
+		manifest << "connections=" << connections << "\n";
+		manifest << "hash=" << hash << "\n";
+		manifest << "journal=" << journal << "\n";
+		manifest << "body=" << bodySize << "\n\n";
+
+		std::string result = manifest.str();
+		result.resize((result.size() + 7) & ~size_t(7), '\n');
+		return result;
+	}
+
+	// Takes the manifest lines up to, not including, the blank line.
+	bool parse(std::istream& lines)
+	{
+		std::string line;
+
+		if (!std::getline(lines, line) || line != signature)
+			return false;
+
+		size_t length = line.size() + 1;
+
+		while (std::getline(lines, line) && line.size())
+		{
+			length += line.size() + 1;
+			size_t equals = line.find('=');
+			if (equals == std::string::npos)
+				continue;
+
+			std::string key = line.substr(0, equals);
+			std::string value = line.substr(equals + 1);
+
+			if (key == "name")
+				name = value;
+			else if (key == "created")
+				created = std::atoll(value.c_str());
+			else if (key == "components")
+				components = std::atoi(value.c_str());
+			else if (key == "terminals")
+				terminals = std::atoi(value.c_str());
+			else if (key == "connections")
+				connections = std::atoi(value.c_str());
+			else if (key == "hash")
+				hash = value;
+			else if (key == "body")
+				bodySize = (size_t)std::atoll(value.c_str());
+			else if (key == "journal")
+				journal = std::atoi(value.c_str());
+		}
+
+		bodyOffset = (length + 1 + 7) & ~size_t(7);
+		return true;
+	}
+};
+
+// One line of saves/catalog.txt: "kind,key,components,terminals,connections,created,thumbnail,name". The key is what
+// Load or PlaceModule takes, the thumbnail is a 16x8 map of where the components sit as 32 hex digits, and the name
+// runs to the end of the line so it can hold commas. A later line for the same key replaces an earlier one.
+struct CatalogEntry
+{
+	std::string kind;  // "save" or "module"
+	std::string key;
+	int components = 0;
+	int terminals = 0;
+	int connections = 0;
+	long long created = 0;
+	std::string thumbnail;
+	std::string name;
+
+	static const int thumbnailWidth = 16;
+	static const int thumbnailHeight = 8;
+
+	std::string line() const
+	{
+		return kind + "," + key + "," + std::to_string(components) + "," + std::to_string(terminals) + "," + std::to_string(connections) + "," + std::to_string(created) + "," + thumbnail + "," + name;
+	}
+
+	bool parse(const std::string& line)
+	{
+		std::stringstream fields(line);
+		std::string rawComponents, rawTerminals, rawConnections, rawCreated;
+
+		if (!std::getline(fields, kind, ',') || !std::getline(fields, key, ',') || !std::getline(fields, rawComponents, ',') || !std::getline(fields, rawTerminals, ',') || !std::getline(fields, rawConnections, ',') || !std::getline(fields, rawCreated, ',') || !std::getline(fields, thumbnail, ','))
+			return false;
+
+		std::getline(fields, name);
+		components = std::atoi(rawComponents.c_str());
+		terminals = std::atoi(rawTerminals.c_str());
+		connections = std::atoi(rawConnections.c_str());
+		created = std::atoll(rawCreated.c_str());
+		return true;
+	}
+
+	bool thumbnailCell(int x, int y) const
+	{
+		int bit = y * thumbnailWidth + x;
+		size_t digit = bit / 4;
+
+		if (digit >= thumbnail.size())
+			return false;
+
+		int value = std::isdigit((unsigned char)thumbnail[digit]) ? thumbnail[digit] - '0' : std::tolower((unsigned char)thumbnail[digit]) - 'a' + 10;
+		return (value >> (3 - bit % 4)) & 1;
+	}
+
+	static std::string makeThumbnail(const std::vector<Component>& parts)
+	{
+		std::vector<int> bits(thumbnailWidth * thumbnailHeight, 0);
+
+		if (parts.size())
+		{
+			olc::vi2d low = parts[0].pos;
+			olc::vi2d high = parts[0].pos;
+
+			for (auto& part : parts)
+			{
+				low = olc::vi2d(std::min(low.x, part.pos.x), std::min(low.y, part.pos.y));
+				high = olc::vi2d(std::max(high.x, part.pos.x), std::max(high.y, part.pos.y));
+			}
+
+			for (auto& part : parts)
+			{
+				int x = high.x > low.x ? int((long long)(part.pos.x - low.x) * (thumbnailWidth - 1) / (high.x - low.x)) : thumbnailWidth / 2;
+				int y = high.y > low.y ? int((long long)(part.pos.y - low.y) * (thumbnailHeight - 1) / (high.y - low.y)) : thumbnailHeight / 2;
+				bits[y * thumbnailWidth + x] = 1;
+			}
+		}
+
+		std::string hex;
+		for (size_t i = 0; i < bits.size(); i += 4)
+			hex += "0123456789abcdef"[bits[i] * 8 + bits[i + 1] * 4 + bits[i + 2] * 2 + bits[i + 3]];
+
+		return hex;
+	}
+};
+
+// Snapshots of designs in the text save format, cut into chunks of whole lines that are stored once under their
+// contentHash, so thousands of near identical saves share everything they have in common. A chunk ends after a line
+// whose hash is a multiple of 16, so an edit only changes the chunks around it and the ones after line up again.
+//   store/chunks.pack     chunk bytes, only ever appended to outside of repack()
+//   store/chunks.txt      "hash,offset,size" for each chunk in the pack
+//   store/snapshots.txt   "key,created,newBytes,hash hash ...", a later line for the same key replaces an earlier one
+// Reference counts are rebuilt from the snapshots when the store is opened. Every call locks, compactions store
+// snapshots from their own thread.
+struct ChunkStore
+{
+	struct Chunk
+	{
+		size_t offset = 0;
+		size_t size = 0;
+		int references = 0;
+	};
+
+	struct Snapshot
+	{
+		std::string key;
+		long long created = 0;
+		size_t newBytes = 0;  // What storing it added to the pack
+		std::vector<std::string> chunks;
+	};
+
+	std::string directory = "store";
+	std::map<std::string, Chunk> chunks;
+	std::vector<Snapshot> snapshots;
+	std::map<std::string, size_t> snapshotIndices;
+	size_t packSize = 0;
+	bool opened = false;
+	std::mutex mutex;
+
+	void open()
+	{
+		if (opened)
+			return;
+
+		opened = true;
+		std::error_code error;
+		packSize = _gfs::exists(directory + "/chunks.pack") ? (size_t)_gfs::file_size(directory + "/chunks.pack", error) : 0;
+
+		std::ifstream index(directory + "/chunks.txt");
+		std::string line;
+
+		// Anything past the end of the pack, or a last line without its newline, was cut short by a crash.
+		while (std::getline(index, line) && !index.eof())
+		{
+			std::stringstream fields(line);
+			std::string hash, offset, size;
+
+			if (std::getline(fields, hash, ',') && std::getline(fields, offset, ',') && std::getline(fields, size))
+			{
+				Chunk chunk = { (size_t)std::atoll(offset.c_str()), (size_t)std::atoll(size.c_str()), 0 };
+				if (chunk.offset + chunk.size <= packSize)
+					chunks[hash] = chunk;
+			}
+		}
+
+		std::ifstream snapshotLines(directory + "/snapshots.txt");
+		while (std::getline(snapshotLines, line) && !snapshotLines.eof())
+		{
+			std::stringstream fields(line);
+			std::string created, newBytes, hash;
+			Snapshot snapshot;
+
+			if (!std::getline(fields, snapshot.key, ',') || !std::getline(fields, created, ',') || !std::getline(fields, newBytes, ','))
+				continue;
+
+			snapshot.created = std::atoll(created.c_str());
+			snapshot.newBytes = (size_t)std::atoll(newBytes.c_str());
+
+			bool complete = true;
+			while (fields >> hash)
+			{
+				complete = complete && chunks.count(hash);
+				snapshot.chunks.push_back(hash);
+			}
+
+			if (complete)
+				setSnapshot(snapshot);
+		}
+
+		for (auto& snapshot : snapshots)
+			for (auto& hash : snapshot.chunks)
+				chunks[hash].references++;
+	}
+
+	void setSnapshot(const Snapshot& snapshot)
+	{
+		auto existing = snapshotIndices.find(snapshot.key);
+
+		if (existing != snapshotIndices.end())
+			snapshots[existing->second] = snapshot;
+		else
+		{
+			snapshotIndices[snapshot.key] = snapshots.size();
+			snapshots.push_back(snapshot);
+		}
+	}
+
+	static bool endsChunk(const char* line, size_t size)
+	{
+		return std::stoull(contentHash(line, size), nullptr, 16) % 16 == 0;
+	}
+
+	// Stores a document under key, replacing what was there. Only chunks the store has not seen before are written.
+	void put(const std::string& key, const std::string& document, long long created)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		open();
+
+		std::error_code error;
+		_gfs::create_directories(directory, error);
+
+		std::ofstream pack(directory + "/chunks.pack", std::ios::binary | std::ios::app);
+		std::stringstream newChunks;
+		Snapshot snapshot = { key, created, 0, {} };
+
+		auto storeChunk = [&](size_t start, size_t end)
+		{
+			std::string hash = contentHash(document.data() + start, end - start);
+			Chunk& chunk = chunks[hash];
+
+			if (!chunk.references && !chunk.size && end > start)
+			{
+				chunk.offset = packSize;
+				chunk.size = end - start;
+				pack.write(document.data() + start, end - start);
+				packSize += chunk.size;
+				snapshot.newBytes += chunk.size;
+				newChunks << hash << "," << chunk.offset << "," << chunk.size << "\n";
+			}
+
+			chunk.references++;
+			snapshot.chunks.push_back(hash);
+		};
+
+		size_t chunkStart = 0;
+		int chunkLines = 0;
+
+		for (size_t lineStart = 0; lineStart < document.size();)
+		{
+			size_t lineEnd = document.find('\n', lineStart);
+			lineEnd = lineEnd == std::string::npos ? document.size() : lineEnd + 1;
+
+			// Every section starts a chunk of its own.
+			if (document[lineStart] == '[' && lineStart > chunkStart)
+			{
+				storeChunk(chunkStart, lineStart);
+				chunkStart = lineStart;
+				chunkLines = 0;
+			}
+
+			chunkLines++;
+			if (endsChunk(document.data() + lineStart, lineEnd - lineStart) || chunkLines == 64)
+			{
+				storeChunk(chunkStart, lineEnd);
+				chunkStart = lineEnd;
+				chunkLines = 0;
+			}
+
+			lineStart = lineEnd;
+		}
+
+		if (chunkStart < document.size())
+			storeChunk(chunkStart, document.size());
+
+		// The pack is written before the index that points into it, and the index before the snapshot.
+		pack.close();
+		std::ofstream(directory + "/chunks.txt", std::ios::app) << newChunks.str();
+
+		auto existing = snapshotIndices.find(key);
+		if (existing != snapshotIndices.end())
+			for (auto& hash : snapshots[existing->second].chunks)
+				chunks[hash].references--;
+
+		setSnapshot(snapshot);
+
+		std::ofstream snapshotLines(directory + "/snapshots.txt", std::ios::app);
+		snapshotLines << key << "," << created << "," << snapshot.newBytes << ",";
+		for (auto& hash : snapshot.chunks)
+			snapshotLines << " " << hash;
+		snapshotLines << "\n";
+	}
+
+	// Each chunk is checked against its hash on the way out.
+	bool get(const std::string& key, std::string& document)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		open();
+
+		auto found = snapshotIndices.find(key);
+		if (found == snapshotIndices.end())
+			return false;
+
+		std::ifstream pack(directory + "/chunks.pack", std::ios::binary);
+		document.clear();
+
+		for (auto& hash : snapshots[found->second].chunks)
+		{
+			const Chunk& chunk = chunks[hash];
+			size_t start = document.size();
+			document.resize(start + chunk.size);
+
+			pack.seekg(chunk.offset);
+			if (!pack.read(&document[start], chunk.size) || contentHash(document.data() + start, chunk.size) != hash)
+			{
+				std::cout << "Chunk " << hash << " of " << key << " is damaged" << std::endl;
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool has(const std::string& key)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		open();
+		return snapshotIndices.count(key) > 0;
+	}
+
+	// Rewrites the store without the chunks no snapshot references any more and without replaced snapshot lines.
+	void repack()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		open();
+
+		std::ifstream oldPack(directory + "/chunks.pack", std::ios::binary);
+		std::ofstream pack(directory + "/chunks.pack.tmp", std::ios::binary);
+		std::ofstream index(directory + "/chunks.txt.tmp");
+		std::map<std::string, Chunk> liveChunks;
+		std::string bytes;
+		size_t offset = 0;
+
+		for (auto& chunk : chunks)
+		{
+			if (chunk.second.references <= 0)
+				continue;
+
+			bytes.resize(chunk.second.size);
+			oldPack.seekg(chunk.second.offset);
+			oldPack.read(&bytes[0], bytes.size());
+			pack.write(bytes.data(), bytes.size());
+
+			liveChunks[chunk.first] = { offset, chunk.second.size, chunk.second.references };
+			index << chunk.first << "," << offset << "," << chunk.second.size << "\n";
+			offset += chunk.second.size;
+		}
+
+		std::ofstream snapshotLines(directory + "/snapshots.txt.tmp");
+		for (auto& snapshot : snapshots)
+		{
+			snapshotLines << snapshot.key << "," << snapshot.created << "," << snapshot.newBytes << ",";
+			for (auto& hash : snapshot.chunks)
+				snapshotLines << " " << hash;
+			snapshotLines << "\n";
+		}
+
+		oldPack.close();
+		pack.close();
+		index.close();
+		snapshotLines.close();
+
+		if (!pack || !index || !snapshotLines)
+			return;
+
+		// A crash between these leaves an index that does not match the pack, which get() notices.
+		std::error_code error;
+		_gfs::rename(directory + "/chunks.pack.tmp", directory + "/chunks.pack", error);
+		_gfs::rename(directory + "/chunks.txt.tmp", directory + "/chunks.txt", error);
+		_gfs::rename(directory + "/snapshots.txt.tmp", directory + "/snapshots.txt", error);
+
+		chunks = liveChunks;
+		packSize = offset;
+	}
+
+	// What the store takes up on disk.
+	size_t storedBytes()
+	{
+		std::error_code error;
+		size_t total = 0;
+
+		for (std::string file : { "/chunks.pack", "/chunks.txt", "/snapshots.txt" })
+			if (_gfs::exists(directory + file))
+				total += (size_t)_gfs::file_size(directory + file, error);
+
+		return total;
+	}
+};
+
+// A module parsed from modules/ once and shared by every instance placed from it. Ids and positions stay relative to
+// the module, only the pins are terminals of the design and each instance owns nothing but its node values.
+struct ModuleDefinition
+{
+	std::string name;
+	std::vector<Component> components;
+	std::vector<Connection> connections;
+	std::vector<Terminal> terminals;
+	std::map<int, int> terminalIndices;
+	std::vector<int> pins;  // Indices into terminals
+	int firstPinId = 0;
+	int lastComponentId = 0;
+	int lastConnectionId = 0;
+	int lastTerminalId = 0;
+	Netlist netlist;
+	std::vector<std::vector<int>> indicatorTerminals;  // By component, see Viscom::findIndicatorTerminals
+	olc::vi2d boundsMin;  // Around every component and terminal, relative like everything else
+	olc::vi2d boundsMax;
+	_gfs::file_time_type modified;  // Newest of the module's files when they were read
+};
+
+// Uniform grid over world positions so drawing only visits what is on screen. Cells hold indices into the design's
+// lists: appended elements are added as they are placed, anything that removes elements rebuilds the grid.
+struct SpatialGrid
+{
+	static constexpr int cellSize = 256;
+
+	struct Cell
+	{
+		olc::vi2d coordinates;
+		std::vector<int> components;
+		std::vector<int> terminals;
+	};
+
+	std::unordered_map<long long, Cell> cells;
+	std::vector<uint32_t> componentStamps;  // Components can sit in several cells, this marks the ones a query already returned
+	uint32_t stamp = 0;
+	bool valid = false;
+
+	static int cellOf(int coordinate)
+	{
+		return coordinate >= 0 ? coordinate / cellSize : (coordinate + 1) / cellSize - 1;
+	}
+
+	Cell& cellAt(int x, int y)
+	{
+		Cell& cell = cells[((long long)x << 32) ^ (uint32_t)y];
+		cell.coordinates = { x, y };
+		return cell;
+	}
+
+	void clear()
+	{
+		cells.clear();
+		componentStamps.clear();
+		valid = true;
+	}
+
+	void addComponent(int index, olc::vi2d low, olc::vi2d high)
+	{
+		for (int y = cellOf(low.y); y <= cellOf(high.y); y++)
+			for (int x = cellOf(low.x); x <= cellOf(high.x); x++)
+				cellAt(x, y).components.push_back(index);
+
+		componentStamps.resize(std::max(componentStamps.size(), size_t(index) + 1));
+	}
+
+	void addTerminal(int index, olc::vi2d pos)
+	{
+		cellAt(cellOf(pos.x), cellOf(pos.y)).terminals.push_back(index);
+	}
+
+	// Everything in the cells the rectangle touches, in the order of the design's lists. Zoomed far out the
+	// rectangle covers more cells than are in use, then only the ones in use are looked at.
+	void query(olc::vi2d low, olc::vi2d high, std::vector<int>& components, std::vector<int>& terminals)
+	{
+		components.clear();
+		terminals.clear();
+		stamp++;
+
+		olc::vi2d lowCell = { cellOf(low.x), cellOf(low.y) };
+		olc::vi2d highCell = { cellOf(high.x), cellOf(high.y) };
+
+		auto visit = [&](const Cell& cell)
+		{
+			for (int index : cell.components)
+				if (componentStamps[index] != stamp)
+				{
+					componentStamps[index] = stamp;
+					components.push_back(index);
+				}
+
+			terminals.insert(terminals.end(), cell.terminals.begin(), cell.terminals.end());
+		};
+
+		if ((long long)(highCell.x - lowCell.x + 1) * (highCell.y - lowCell.y + 1) > (long long)cells.size())
+		{
+			for (auto& cell : cells)
+				if (cell.second.coordinates.x >= lowCell.x && cell.second.coordinates.x <= highCell.x && cell.second.coordinates.y >= lowCell.y && cell.second.coordinates.y <= highCell.y)
+					visit(cell.second);
+		}
+		else
+		{
+			for (int y = lowCell.y; y <= highCell.y; y++)
+				for (int x = lowCell.x; x <= highCell.x; x++)
+				{
+					auto cell = cells.find(((long long)x << 32) ^ (uint32_t)y);
+					if (cell != cells.end())
+						visit(cell->second);
+				}
+		}
+
+		std::sort(components.begin(), components.end());
+		std::sort(terminals.begin(), terminals.end());
+	}
+};
+
+// Wire end points as flat arrays, moved to screen space all at once when the view changes rather than
+// per wire per frame. The wires that cross the screen are found on the way, see Viscom::findVisible.
+struct WireGeometry
+{
+	std::vector<float> ax, ay, bx, by;  // World, one per connection
+	std::vector<int> screenAX, screenAY, screenBX, screenBY;
+	std::vector<int> onScreen;
+	olc::vf2d offset, scale;
+	olc::vi2d screenSize;
+	bool transformed = false;
+
+	void resize(size_t count)
+	{
+		ax.resize(count);
+		ay.resize(count);
+		bx.resize(count);
+		by.resize(count);
+		transformed = false;
+	}
+
+	void add(olc::vi2d a, olc::vi2d b)
+	{
+		ax.push_back((float)a.x);
+		ay.push_back((float)a.y);
+		bx.push_back((float)b.x);
+		by.push_back((float)b.y);
+		transformed = false;
+	}
+
+	// Same sums as olc::panzoom::WorldToScreen so the lines land on the same pixels.
+	void transform(olc::vf2d viewOffset, olc::vf2d viewScale, olc::vi2d viewSize)
+	{
+		if (transformed && offset == viewOffset && scale == viewScale && screenSize == viewSize)
+			return;
+
+		offset = viewOffset;
+		scale = viewScale;
+		screenSize = viewSize;
+		transformed = true;
+
+		size_t count = ax.size();
+		screenAX.resize(count);
+		screenAY.resize(count);
+		screenBX.resize(count);
+		screenBY.resize(count);
+
+		const float* worldAX = ax.data();
+		const float* worldAY = ay.data();
+		const float* worldBX = bx.data();
+		const float* worldBY = by.data();
+		int* outAX = screenAX.data();
+		int* outAY = screenAY.data();
+		int* outBX = screenBX.data();
+		int* outBY = screenBY.data();
+
+		for (size_t i = 0; i < count; i++)
+		{
+			outAX[i] = (int)((worldAX[i] - offset.x) * scale.x);
+			outAY[i] = (int)((worldAY[i] - offset.y) * scale.y);
+			outBX[i] = (int)((worldBX[i] - offset.x) * scale.x);
+			outBY[i] = (int)((worldBY[i] - offset.y) * scale.y);
+		}
+
+		onScreen.clear();
+
+		for (size_t i = 0; i < count; i++)
+		{
+			bool off = std::max(outAX[i], outBX[i]) < 0 || std::min(outAX[i], outBX[i]) >= screenSize.x
+				|| std::max(outAY[i], outBY[i]) < 0 || std::min(outAY[i], outBY[i]) >= screenSize.y;
+
+			if (!off)
+				onScreen.push_back((int)i);
+		}
+	}
+};
+
+// The design coarsened for one zoom bucket: wires and components binned into square tiles a few screen
+// pixels across, so a zoomed out frame draws one box per tile in use, see Viscom::DrawLodTiles.
+struct LodLevel
+{
+	struct Tile
+	{
+		olc::vi2d coordinates;
+		bool components = false;
+		std::vector<int> connections;
+	};
+
+	int tileSize = 1;  // World units
+	std::vector<Tile> tiles;
+	std::unordered_map<long long, int> tileIndices;
+
+	int tileOf(int coordinate) const
+	{
+		return coordinate >= 0 ? coordinate / tileSize : (coordinate + 1) / tileSize - 1;
+	}
+
+	Tile& tileAt(int x, int y)
+	{
+		auto index = tileIndices.emplace(((long long)x << 32) ^ (uint32_t)y, (int)tiles.size());
+
+		if (index.second)
+		{
+			tiles.emplace_back();
+			tiles.back().coordinates = { x, y };
+		}
+
+		return tiles[index.first->second];
+	}
+
+	void addComponent(olc::vi2d low, olc::vi2d high)
+	{
+		for (int y = tileOf(low.y); y <= tileOf(high.y); y++)
+			for (int x = tileOf(low.x); x <= tileOf(high.x); x++)
+				tileAt(x, y).components = true;
+	}
+
+	// Walks the wire in half tile steps. A straight line never comes back to a tile it left, so a tile it
+	// passes through gets it once.
+	void addConnection(int index, olc::vi2d a, olc::vi2d b)
+	{
+		olc::vi2d delta = b - a;
+		int steps = std::max(std::abs(delta.x), std::abs(delta.y)) * 2 / tileSize + 1;
+
+		for (int i = 0; i <= steps; i++)
+		{
+			olc::vi2d point = a + olc::vi2d(int((long long)delta.x * i / steps), int((long long)delta.y * i / steps));
+			Tile& tile = tileAt(tileOf(point.x), tileOf(point.y));
+
+			if (tile.connections.empty() || tile.connections.back() != index)
+				tile.connections.push_back(index);
+		}
+	}
+
+	void query(olc::vi2d low, olc::vi2d high, std::vector<int>& visible) const
+	{
+		visible.clear();
+
+		olc::vi2d lowTile = { tileOf(low.x), tileOf(low.y) };
+		olc::vi2d highTile = { tileOf(high.x), tileOf(high.y) };
+
+		if ((long long)(highTile.x - lowTile.x + 1) * (highTile.y - lowTile.y + 1) > (long long)tiles.size())
+		{
+			for (size_t i = 0; i < tiles.size(); i++)
+				if (tiles[i].coordinates.x >= lowTile.x && tiles[i].coordinates.x <= highTile.x && tiles[i].coordinates.y >= lowTile.y && tiles[i].coordinates.y <= highTile.y)
+					visible.push_back((int)i);
+		}
+		else
+		{
+			for (int y = lowTile.y; y <= highTile.y; y++)
+				for (int x = lowTile.x; x <= highTile.x; x++)
+				{
+					auto index = tileIndices.find(((long long)x << 32) ^ (uint32_t)y);
+					if (index != tileIndices.end())
+						visible.push_back(index->second);
+				}
+		}
+	}
+};
+
+// Worker threads that each take the next index of a job until all are done. The thread that calls run
+// works on the job too and returns when it is finished.
+struct WorkerPool
+{
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	std::function<void(int)> job;
+	int jobSize = 0;
+	std::atomic<int> next{ 0 };
+	int running = 0;
+	uint64_t generation = 0;
+	bool stopping = false;
+
+	~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+
+		wake.notify_all();
+
+		for (auto& thread : threads)
+			thread.join();
+	}
+
+	void start(int threadCount)
+	{
+		for (int i = 0; i < threadCount; i++)
+			threads.emplace_back([this]()
+			{
+				uint64_t seen = 0;
+				std::unique_lock<std::mutex> lock(mutex);
+
+				while (true)
+				{
+					wake.wait(lock, [&]() { return stopping || generation != seen; });
+
+					if (stopping)
+						return;
+
+					seen = generation;
+					lock.unlock();
+					work();
+					lock.lock();
+
+					if (--running == 0)
+						done.notify_one();
+				}
+			});
+	}
+
+	void work()
+	{
+		for (int index = next++; index < jobSize; index = next++)
+			job(index);
+	}
+
+	void run(int size, std::function<void(int)> function)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = std::move(function);
+			jobSize = size;
+			next = 0;
+			running = (int)threads.size();
+			generation++;
+		}
+
+		wake.notify_all();
+		work();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [&]() { return running == 0; });
+	}
+};
+
+// What of the visible part of the design touches one square of the screen, see Viscom::binVisible.
+struct ScreenTile
+{
+	olc::vi2d low;
+	olc::vi2d high;  // Exclusive
+	std::vector<int> components;
+	std::vector<int> terminals;
+	std::vector<int> connections;
+	std::vector<int> lodTiles;
+};
+
+// Writes an image as an 8 bit RGBA PNG. olc only reads images, so the deflate stream is made here: fixed Huffman
+// codes, with repeats of the pixel before and of the row above as the only matches. Rendered designs are mostly
+// runs of one colour, which that covers.
+bool writePng(const std::string& path, const olc::Sprite& image)
+{
+	std::vector<uint8_t> raw;
+	size_t stride = size_t(image.width) * 4 + 1;
+	raw.reserve(stride * image.height);
+
+	for (int y = 0; y < image.height; y++)
+	{
+		raw.push_back(0);  // No filter
+
+		for (int x = 0; x < image.width; x++)
+		{
+			olc::Pixel pixel = image.pColData[y * image.width + x];
+			raw.insert(raw.end(), { pixel.r, pixel.g, pixel.b, pixel.a });
+		}
+	}
+
+	std::vector<uint8_t> zlib = { 0x78, 0x01 };
+	uint32_t bitBuffer = 0;
+	int bitCount = 0;
+
+	auto bits = [&](uint32_t value, int count)
+	{
+		bitBuffer |= value << bitCount;
+		bitCount += count;
+
+		while (bitCount >= 8)
+		{
+			zlib.push_back(uint8_t(bitBuffer));
+			bitBuffer >>= 8;
+			bitCount -= 8;
+		}
+	};
+
+	// Huffman codes go out most significant bit first.
+	auto code = [&](uint32_t value, int count)
+	{
+		uint32_t reversed = 0;
+		for (int i = 0; i < count; i++)
+			reversed |= ((value >> i) & 1) << (count - 1 - i);
+		bits(reversed, count);
+	};
+
+	auto symbol = [&](int value)
+	{
+		if (value < 144)
+			code(0x30 + value, 8);
+		else if (value < 256)
+			code(0x190 + value - 144, 9);
+		else if (value < 280)
+			code(value - 256, 7);
+		else
+			code(0xC0 + value - 280, 8);
+	};
+
+	static const int lengthBases[] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static const int lengthExtra[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static const int distanceBases[] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	static const int distanceExtra[] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	auto match = [&](int length, int distance)
+	{
+		int lengthCode = 28;
+		while (lengthBases[lengthCode] > length)
+			lengthCode--;
+		symbol(257 + lengthCode);
+		bits(length - lengthBases[lengthCode], lengthExtra[lengthCode]);
+
+		int distanceCode = 29;
+		while (distanceBases[distanceCode] > distance)
+			distanceCode--;
+		code(distanceCode, 5);
+		bits(distance - distanceBases[distanceCode], distanceExtra[distanceCode]);
+	};
+
+	bits(1, 1);  // The only block
+	bits(1, 2);  // Fixed codes
+
+	size_t candidates[2] = { 4, stride };
+	for (size_t i = 0; i < raw.size();)
+	{
+		int bestLength = 0;
+		size_t bestDistance = 0;
+
+		for (size_t distance : candidates)
+		{
+			if (distance > i || distance > 32768)
+				continue;
+
+			int length = 0;
+			while (length < 258 && i + length < raw.size() && raw[i + length] == raw[i + length - distance])
+				length++;
+
+			if (length > bestLength)
+			{
+				bestLength = length;
+				bestDistance = distance;
+			}
+		}
+
+		if (bestLength >= 3)
+		{
+			match(bestLength, (int)bestDistance);
+			i += bestLength;
+		}
+		else
+			symbol(raw[i++]);
+	}
+
+	symbol(256);
+	bits(0, 7);
+
+	uint32_t a = 1, b = 0;
+	for (uint8_t byte : raw)
+	{
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+
+	for (int shift = 24; shift >= 0; shift -= 8)
+		zlib.push_back(uint8_t(((b << 16) | a) >> shift));
+
+	std::ofstream file(path, std::ios::binary);
+
+	auto chunk = [&](const char* type, const std::vector<uint8_t>& data)
+	{
+		std::vector<uint8_t> bytes(type, type + 4);
+		bytes.insert(bytes.end(), data.begin(), data.end());
+
+		uint32_t crc = 0xFFFFFFFF;
+		for (uint8_t byte : bytes)
+		{
+			crc ^= byte;
+			for (int k = 0; k < 8; k++)
+				crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+		}
+		crc ^= 0xFFFFFFFF;
+
+		uint32_t size = (uint32_t)data.size();
+		uint8_t sizeBytes[4] = { uint8_t(size >> 24), uint8_t(size >> 16), uint8_t(size >> 8), uint8_t(size) };
+		uint8_t crcBytes[4] = { uint8_t(crc >> 24), uint8_t(crc >> 16), uint8_t(crc >> 8), uint8_t(crc) };
+		file.write((const char*)sizeBytes, 4);
+		file.write((const char*)bytes.data(), bytes.size());
+		file.write((const char*)crcBytes, 4);
+	};
+
+	uint8_t header[13] = { uint8_t(image.width >> 24), uint8_t(image.width >> 16), uint8_t(image.width >> 8), uint8_t(image.width), uint8_t(image.height >> 24), uint8_t(image.height >> 16), uint8_t(image.height >> 8), uint8_t(image.height), 8, 6, 0, 0, 0 };
+	file.write("\x89PNG\r\n\x1a\n", 8);
+	chunk("IHDR", std::vector<uint8_t>(header, header + 13));
+	chunk("IDAT", zlib);
+	chunk("IEND", {});
+
+	return bool(file);
+}
+
+// Tells when a file in a directory is written or replaced, without blocking: inotify on Linux and a change
+// notification on Windows. Elsewhere nothing is ever reported.
+struct DirectoryWatcher
+{
+#if defined(_WIN32)
+	HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+	int fd = -1;
+#endif
+
+	DirectoryWatcher() = default;
+	DirectoryWatcher(const DirectoryWatcher&) = delete;
+	DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+	~DirectoryWatcher()
+	{
+#if defined(_WIN32)
+		if (handle != INVALID_HANDLE_VALUE)
+			FindCloseChangeNotification(handle);
+#else
+		if (fd >= 0)
+			::close(fd);
+#endif
+	}
+
+	bool open(const std::string& directory)
+	{
+#if defined(_WIN32)
+		handle = FindFirstChangeNotificationA(directory.c_str(), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+		return handle != INVALID_HANDLE_VALUE;
+#elif defined(__linux__)
+		fd = inotify_init1(IN_NONBLOCK);
+		if (fd >= 0 && inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+		{
+			::close(fd);
+			fd = -1;
+		}
+
+		return fd >= 0;
+#else
+		return false;
+#endif
+	}
+
+	// True if anything changed since the last call.
+	bool changed()
+	{
+#if defined(_WIN32)
+		if (handle == INVALID_HANDLE_VALUE || WaitForSingleObject(handle, 0) != WAIT_OBJECT_0)
+			return false;
+
+		FindNextChangeNotification(handle);
+		return true;
+#else
+		bool anything = false;
+		char events[4096];
+
+		while (fd >= 0 && ::read(fd, events, sizeof(events)) > 0)
+			anything = true;
+
+		return anything;
+#endif
+	}
+};
+
+// Rolling history of how long each part of a frame took, and of how much work each settle pass did, for the
+// profiler panel. Timers nest: time spent in an inner one is taken off the one around it.
+struct Profiler
+{
+	enum Series { INPUT, CLOCK, SETTLE, BEHAVIOURAL, SOURCES, DRAW, WAVES, TRANSISTORS, CONNECTIONS, SERIES_COUNT };
+	static constexpr int timedSeries = DRAW + 1;  // Milliseconds per frame, the rest are counts per settle
+	static constexpr const char* names[SERIES_COUNT] = { "INPUT AND EDITS", "CLOCK", "SETTLE", "COMPONENTS", "SOURCE WIRES", "DRAW", "WAVES", "TRANSISTORS", "CONNECTIONS" };
+	static constexpr int historySize = 240;
+
+	bool enabled = false;
+	std::vector<double> history[SERIES_COUNT];  // Ring buffers, oldest at next once full
+	int next[SERIES_COUNT] = {};
+	double frame[SERIES_COUNT] = {};
+	bool frameDrawn = false;  // The timed series are sampled once per frame shown, updates in between add up
+	int open = -1;  // The innermost running timer
+
+	struct Timer
+	{
+		Profiler& profiler;
+		int series;
+		int parent;
+		bool running;
+		std::chrono::steady_clock::time_point start;
+
+		Timer(Profiler& profiler, int series) : profiler(profiler), series(series), parent(profiler.open), running(profiler.enabled)
+		{
+			if (running)
+			{
+				profiler.open = series;
+				start = std::chrono::steady_clock::now();
+			}
+		}
+
+		~Timer()
+		{
+			if (!running)
+				return;
+
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			profiler.frame[series] += ms;
+			if (parent >= 0)
+				profiler.frame[parent] -= ms;
+
+			profiler.open = parent;
+		}
+	};
+
+	void sample(int series, double value)
+	{
+		if (!enabled)
+			return;
+
+		if ((int)history[series].size() < historySize)
+			history[series].push_back(value);
+		else
+			history[series][next[series]] = value;
+
+		next[series] = (next[series] + 1) % historySize;
+	}
+
+	void endFrame()
+	{
+		if (!frameDrawn)
+			return;
+
+		frameDrawn = false;
+
+		for (int series = 0; series < timedSeries; series++)
+		{
+			sample(series, frame[series]);
+			frame[series] = 0;
+		}
+	}
+
+	// Oldest first.
+	std::vector<double> ordered(int series) const
+	{
+		const std::vector<double>& values = history[series];
+		if ((int)values.size() < historySize)
+			return values;
+
+		std::vector<double> result(values.begin() + next[series], values.end());
+		result.insert(result.end(), values.begin(), values.begin() + next[series]);
+		return result;
+	}
+
+	void stats(int series, double& low, double& average, double& p99) const
+	{
+		std::vector<double> values = history[series];
+		low = average = p99 = 0;
+
+		if (values.empty())
+			return;
+
+		low = *std::min_element(values.begin(), values.end());
+
+		for (double value : values)
+			average += value;
+		average /= values.size();
+
+		auto rank = values.begin() + (values.size() * 99) / 100;
+		std::nth_element(values.begin(), rank, values.end());
+		p99 = *rank;
+	}
+};
+
+// The parts of a design and the reading of one from its files, kept apart from the engine so a design can be read
+// on another thread and swapped in, see Viscom::LoadInBackground.
+struct Design
+{
+	std::vector<Component> components;
+	std::vector<Connection> connections;
+	std::vector<Connection*> sourceConnections;
+	std::vector<Terminal> terminals;
+	int lastTerminalId = 4;
+	int lastConnectionId = 1;
+	int lastComponentId = 2;
+	int snapshotGeneration = 0;  // Journal generation the design's container starts from
+	std::atomic<float> loadProgress { 0 };
+	std::map<std::string, std::string, std::less<>> terminalTypes;  // Spelling in a file to terminal type, see internTerminalType
+
+	// Everything Load does to the design itself, so it can run on the load thread. Returns the journal generation
+	// to carry on appending to.
+	int readDesign(std::string load_timestamp, ChunkStore& history)
+	{
+		// Saves from before the container format are four text files, or only in the history store once imported.
+		loadProgress = 0.1f;
+		snapshotGeneration = 0;
+		bool container = LoadContainer("saves/" + load_timestamp + ".vsave");
+		std::string document;
+
+		if (!container && !_gfs::exists("saves/" + load_timestamp + "_terminals.txt") && (history.get(load_timestamp, document) || history.get("saves/" + load_timestamp, document)))
+			LoadDocument(document);
+		else if (!container)
+			LoadText("saves/" + load_timestamp + "_");
+
+		// Then every edit made since the snapshot, oldest journal first.
+		loadProgress = 0.6f;
+		int generation = snapshotGeneration;
+		while (replayJournal(journalPath(load_timestamp, generation)))
+			generation++;
+
+		loadProgress = 0.8f;
+		if (!container || generation > snapshotGeneration)
+			updateSourceConnections();
+
+		loadProgress = 1.0f;
+		return std::max(snapshotGeneration, generation - 1);
+	}
+
+	static std::string journalPath(std::string design, int generation)
+	{
+		return "saves/" + design + "." + std::to_string(generation) + ".journal";
+	}
+
+	// Returns false if there is no such journal. Stops at a line cut short by a crash.
+	bool replayJournal(std::string path)
+	{
+		std::ifstream journal(path, std::ios::binary);
+		if (!journal.is_open())
+			return false;
+
+		std::string line;
+		while (std::getline(journal, line) && !journal.eof())
+		{
+			if (line.empty())
+				continue;
+
+			std::vector<std::string> fields;
+			std::stringstream lineFields(line);
+			std::string field;
+
+			// The type is last and keeps any commas in it.
+			size_t fieldCount = line[0] == 'C' || line[0] == 'T' ? 6 : 9;
+			while (fields.size() + 1 < fieldCount && std::getline(lineFields, field, ','))
+				fields.push_back(field);
+			if (std::getline(lineFields, field))
+				fields.push_back(field);
+
+			auto number = [&](size_t i) { return i < fields.size() ? std::atoi(fields[i].c_str()) : 0; };
+			auto removeAt = [&](auto& elements)
+			{
+				size_t index = (size_t)number(1);
+				if (index < elements.size())
+					elements.erase(elements.begin() + index);
+			};
+
+			if (fields[0] == "C" && fields.size() == 6)
+				components.push_back({ number(1), fields[5], { number(2), number(3) }, number(4) });
+			else if (fields[0] == "T" && fields.size() == 6)
+				terminals.push_back({ number(1), { number(2), number(3) }, false, fields[5], number(4) });
+			else if (fields[0] == "W" && fields.size() == 9)
+				connections.push_back({ number(1), number(2), number(3), { number(4), number(5) }, { number(6), number(7) }, number(8) });
+			else if (fields[0] == "-C")
+				removeAt(components);
+			else if (fields[0] == "-T")
+				removeAt(terminals);
+			else if (fields[0] == "-W")
+				removeAt(connections);
+			else if (fields[0] == "G" && fields.size() == 4)
+			{
+				lastTerminalId = number(1);
+				lastConnectionId = number(2);
+				lastComponentId = number(3);
+			}
+		}
+
+		return true;
+	}
+
+	void LoadText(std::string filepath)
+	{
+		MappedFile files[4];
+		std::vector<CsvReader> readers;
+
+		for (std::string section : { "globals", "components", "connections", "terminals" })
+		{
+			MappedFile& file = files[readers.size()];
+			file.open(filepath + section + ".txt");
+			readers.push_back(CsvReader((const char*)file.data, file.size, filepath + section + ".txt"));
+		}
+
+		LoadText(readers[0], readers[1], readers[2], readers[3]);
+	}
+
+	void LoadText(CsvReader& globalsReader, CsvReader& componentsReader, CsvReader& connectionsReader, CsvReader& terminalsReader)
+	{
+		readGlobals(globalsReader, lastTerminalId, lastConnectionId, lastComponentId);
+
+		components.clear();
+		readComponents(componentsReader, components);
+
+		connections.clear();
+		readConnections(connectionsReader, connections);
+
+		terminals.clear();
+		readTerminals(terminalsReader, terminals);
+	}
+
+	// The text save and module files. Each reader keeps what it read up to a bad line and reports that line.
+	bool readGlobals(CsvReader& reader, int& terminalId, int& connectionId, int& componentId)
+	{
+		for (int* global : { &terminalId, &connectionId, &componentId })
+			if (!reader.nextRecord() || !reader.number(*global) || !reader.endRecord())
+				break;
+
+		return csvReadBack(reader);
+	}
+
+	bool readComponents(CsvReader& reader, std::vector<Component>& into)
+	{
+		while (reader.nextRecord())
+		{
+			Component component;
+
+			if (!reader.number(component.id))
+				break;
+
+			component.type = reader.text();
+
+			if (!reader.number(component.pos.x) || !reader.number(component.pos.y) || !reader.optionalNumber(component.width) || !reader.endRecord())
+				break;
+
+			into.push_back(component);
+		}
+
+		return csvReadBack(reader);
+	}
+
+	bool readConnections(CsvReader& reader, std::vector<Connection>& into)
+	{
+		while (reader.nextRecord())
+		{
+			Connection connection;
+
+			if (!reader.number(connection.id) || !reader.number(connection.terminalA) || !reader.number(connection.terminalB)
+				|| !reader.number(connection.terminalAPos.x) || !reader.number(connection.terminalAPos.y)
+				|| !reader.number(connection.terminalBPos.x) || !reader.number(connection.terminalBPos.y)
+				|| !reader.number(connection.notOutTerminal) || !reader.endRecord())
+				break;
+
+			into.push_back(connection);
+		}
+
+		return csvReadBack(reader);
+	}
+
+	bool readTerminals(CsvReader& reader, std::vector<Terminal>& into)
+	{
+		while (reader.nextRecord())
+		{
+			Terminal terminal;
+			terminal.state = false;
+
+			if (!reader.number(terminal.id) || !reader.number(terminal.pos.x) || !reader.number(terminal.pos.y))
+				break;
+
+			terminal.type = internTerminalType(reader.text());
+
+			if (!reader.number(terminal.componentId) || !reader.endRecord())
+				break;
+
+			into.push_back(terminal);
+		}
+
+		return csvReadBack(reader);
+	}
+
+	bool csvReadBack(const CsvReader& reader)
+	{
+		if (reader.error.size())
+			std::cout << reader.error << std::endl;
+
+		return reader.error.empty();
+	}
+
+	// Expanded once per distinct spelling, looked up without building a string.
+	const std::string& internTerminalType(std::string_view type)
+	{
+		auto interned = terminalTypes.find(type);
+
+		if (interned == terminalTypes.end())
+			interned = terminalTypes.emplace(std::string(type), expandTerminalType(std::string(type))).first;
+
+		return interned->second;
+	}
+
+	void LoadDocument(const std::string& document)
+	{
+		std::map<std::string, std::string_view> sections;
+		std::string section;
+		size_t sectionStart = 0;
+
+		for (size_t lineStart = 0; lineStart < document.size();)
+		{
+			size_t lineEnd = document.find('\n', lineStart);
+			lineEnd = lineEnd == std::string::npos ? document.size() : lineEnd + 1;
+
+			if (document[lineStart] == '[')
+			{
+				sections[section] = std::string_view(document.data() + sectionStart, lineStart - sectionStart);
+				section = document.substr(lineStart + 1, document.find(']', lineStart) - lineStart - 1);
+				sectionStart = lineEnd;
+			}
+
+			lineStart = lineEnd;
+		}
+
+		sections[section] = std::string_view(document.data() + sectionStart, document.size() - sectionStart);
+
+		std::vector<CsvReader> readers;
+		for (std::string name : { "globals", "components", "connections", "terminals" })
+			readers.push_back(CsvReader(sections[name].data(), sections[name].size(), "[" + name + "]"));
+
+		LoadText(readers[0], readers[1], readers[2], readers[3]);
+	}
+
+	// Returns false if there is no container or it does not check out, so the caller can fall back to the text files.
+	bool LoadContainer(std::string path)
+	{
+		MappedFile file;
+		SaveManifest manifest;
+
+		if (!file.open(path))
+			return false;
+
+		const char* manifestEnd = std::search((const char*)file.data, (const char*)file.data + file.size, "\n\n", "\n\n" + 2);
+		std::stringstream manifestText(std::string((const char*)file.data, manifestEnd));
+
+		if (!manifest.parse(manifestText) || manifest.bodyOffset + manifest.bodySize != file.size)
+			return false;
+
+		const uint8_t* body = file.data + manifest.bodyOffset;
+
+		if (contentHash(body, manifest.bodySize) != manifest.hash)
+		{
+			std::cout << path << " is damaged, its contents do not match the manifest" << std::endl;
+			return false;
+		}
+
+		snapshotGeneration = manifest.journal;
+
+		return decodeBinary(body, manifest.bodySize);
+	}
+
+	// Builds the design straight from a binary body, every size and index is checked first.
+	bool decodeBinary(const uint8_t* data, size_t size)
+	{
+		if (size < sizeof(BinarySave::Header))
+			return false;
+
+		const BinarySave::Header& header = *(const BinarySave::Header*)data;
+
+		if (header.magic != BinarySave::magic || header.version != BinarySave::version)
+			return false;
+
+		size_t componentsOffset = sizeof(BinarySave::Header);
+		size_t terminalsOffset = componentsOffset + size_t(header.componentCount) * sizeof(BinarySave::ComponentRecord);
+		size_t connectionsOffset = terminalsOffset + size_t(header.terminalCount) * sizeof(BinarySave::TerminalRecord);
+		size_t stringOffsetsOffset = connectionsOffset + size_t(header.connectionCount) * sizeof(BinarySave::ConnectionRecord);
+		size_t stringBytesOffset = stringOffsetsOffset + (size_t(header.stringCount) + 1) * sizeof(uint32_t);
+		size_t adjacencyOffsetsOffset = stringBytesOffset + header.stringBytes;
+		size_t adjacencyOffset = adjacencyOffsetsOffset + (size_t(header.terminalCount) + 1) * sizeof(uint32_t);
+
+		if (header.stringBytes % 4 || adjacencyOffset + size_t(header.adjacencyCount) * sizeof(uint32_t) != size)
+			return false;
+
+		const BinarySave::ComponentRecord* componentRecords = (const BinarySave::ComponentRecord*)(data + componentsOffset);
+		const BinarySave::TerminalRecord* terminalRecords = (const BinarySave::TerminalRecord*)(data + terminalsOffset);
+		const BinarySave::ConnectionRecord* connectionRecords = (const BinarySave::ConnectionRecord*)(data + connectionsOffset);
+		const uint32_t* stringOffsets = (const uint32_t*)(data + stringOffsetsOffset);
+		const uint32_t* adjacencyOffsets = (const uint32_t*)(data + adjacencyOffsetsOffset);
+		const uint32_t* adjacency = (const uint32_t*)(data + adjacencyOffset);
+
+		std::vector<std::string> strings;
+		for (uint32_t i = 0; i < header.stringCount; i++)
+		{
+			if (stringOffsets[i] > stringOffsets[i + 1] || stringOffsets[i + 1] > header.stringBytes)
+				return false;
+
+			strings.emplace_back((const char*)data + stringBytesOffset + stringOffsets[i], stringOffsets[i + 1] - stringOffsets[i]);
+		}
+
+		for (uint32_t i = 0; i < header.componentCount; i++)
+			if (componentRecords[i].type >= header.stringCount)
+				return false;
+
+		for (uint32_t i = 0; i < header.terminalCount; i++)
+			if (terminalRecords[i].type >= header.stringCount || adjacencyOffsets[i] > adjacencyOffsets[i + 1])
+				return false;
+
+		if (adjacencyOffsets[header.terminalCount] != header.adjacencyCount)
+			return false;
+
+		for (uint32_t i = 0; i < header.adjacencyCount; i++)
+			if (adjacency[i] >= header.connectionCount)
+				return false;
+
+		lastTerminalId = header.lastTerminalId;
+		lastConnectionId = header.lastConnectionId;
+		lastComponentId = header.lastComponentId;
+
+		components.clear();
+		components.reserve(header.componentCount);
+		for (uint32_t i = 0; i < header.componentCount; i++)
+		{
+			const BinarySave::ComponentRecord& record = componentRecords[i];
+			components.push_back({ record.id, strings[record.type], olc::vi2d(record.x, record.y), record.width });
+		}
+
+		terminals.clear();
+		terminals.reserve(header.terminalCount);
+		for (uint32_t i = 0; i < header.terminalCount; i++)
+		{
+			const BinarySave::TerminalRecord& record = terminalRecords[i];
+			terminals.push_back({ record.id, olc::vi2d(record.x, record.y), false, strings[record.type], record.componentId });
+		}
+
+		connections.clear();
+		connections.reserve(header.connectionCount);
+		for (uint32_t i = 0; i < header.connectionCount; i++)
+		{
+			const BinarySave::ConnectionRecord& record = connectionRecords[i];
+			connections.push_back({ record.id, record.terminalA, record.terminalB, olc::vi2d(record.terminalAX, record.terminalAY), olc::vi2d(record.terminalBX, record.terminalBY), record.notOutTerminal });
+		}
+
+		// Same connections, in the same order, as updateSourceConnections picks by searching every terminal.
+		std::vector<uint32_t> sources;
+		for (uint32_t i = 0; i < header.terminalCount; i++)
+		{
+			const Terminal& terminal = terminals[i];
+
+			if (terminal.id == 1 || terminal.id == 3 || terminal.type == "gatedOut" || isBehaviouralOutput(terminal.type))
+				sources.insert(sources.end(), adjacency + adjacencyOffsets[i], adjacency + adjacencyOffsets[i + 1]);
+		}
+
+		std::sort(sources.begin(), sources.end());
+
+		sourceConnections.clear();
+		for (uint32_t connection : sources)
+			sourceConnections.push_back(&connections[connection]);
+
+		return true;
+	}
+
+	Terminal* findTerminal(int id)
+	{
+		for (auto& terminal : terminals)
+		{
+			if (terminal.id == id)
+				return &terminal;
+		}
+
+		return nullptr;
+	}
+
+	void updateSourceConnections()
+	{
+		sourceConnections.clear();
+
+		for (auto& connection : connections)
+		{
+			if (connection.terminalA == 1 || connection.terminalA == 3)
+				sourceConnections.push_back(&connection);
+			else
+			{
+				Terminal* thisTerminalA = findTerminal(connection.terminalA);
+				if (thisTerminalA)
+				{
+					if (thisTerminalA->type == "gatedOut" || isBehaviouralOutput(thisTerminalA->type))
+						sourceConnections.push_back(&connection);
+				}
+			}
+		}
+	}
+
+	// Returns the bit number of a numbered terminal type, e.g. 12 for ("aluInA12", "aluInA"), or 0 if the type is not part of that family.
+	int terminalBit(const std::string& type, const char* prefix)
+	{
+		size_t prefixLength = strlen(prefix);
+
+		if (type.size() <= prefixLength || type.compare(0, prefixLength, prefix) != 0)
+			return 0;
+
+		int bit = 0;
+		for (size_t i = prefixLength; i < type.size(); i++)
+		{
+			if (type[i] < '0' || type[i] > '9')
+				return 0;
+
+			bit = bit * 10 + (type[i] - '0');
+		}
+
+		return bit;
+	}
+
+	// Older saves and the module files store terminal types as single characters.
+	std::string expandTerminalType(const std::string& type)
+	{
+		static const std::map<std::string, std::string> typeChars = {
+			{ "S", "sourceStart" },
+			{ "Z", "sourceEnd" },
+			{ "L", "clock" },
+			{ "C", "transCollector" },
+			{ "B", "transBase" },
+			{ "E", "transEmitter" },
+			{ "N", "transNotOut" },
+			{ "U", "buffer" },
+			{ "D", "gatedIn" },
+			{ "W", "gatedWriteEnable" },
+			{ "Q", "gatedOut" },
+		};
+
+		auto typeChar = typeChars.find(type);
+		return typeChar != typeChars.end() ? typeChar->second : type;
+	}
+
+	// Outputs of the simulated components keep their state between simulation passes and act as sources.
+	bool isBehaviouralOutput(const std::string& type)
+	{
+		return terminalBit(type, "aluOut") || terminalBit(type, "ramOut") || terminalBit(type, "counterOut") || terminalBit(type, "microcounterOut") || terminalBit(type, "IROut") || terminalBit(type, "IRDecodeOut") || terminalBit(type, "decoderOut") || terminalBit(type, "flagsRegOut") || type == "aluZeroFlagOut" || type == "aluCarryFlagOut" || type == "moduleOut";
+	}
+};
+
+class Viscom : public olc::PixelGameEngine, public Design
+{
+public:
+	Viscom()
+	{
+		sAppName = "viscom";
+	}
+
+	~Viscom()
+	{
+		finishSave();
+
+		if (loadThread.joinable())
+			loadThread.join();
+	}
+
+public:
+	bool OnUserCreate() override
+	{
+		pz.Create(this);
+		pz.SetOffset({ (float)-ScreenWidth() * 0.5f, (float)-ScreenHeight() * 0.5f });
+
+		if (!componentBuilderMode)
+		{
+			terminals.push_back({ 1, { 25, 0 }, true, "sourceStart", 1 });
+			terminals.push_back({ 2, { -25, 0 }, false, "sourceEnd", 1 });
+			terminals.push_back({ 3, { -200, 0 }, false, "clock", 1 });
+			terminals.push_back({ lastTerminalId, { -200, -20 }, false, "clockHalt", 0 });
+			lastTerminalId++;
+		}
+
+		loadModuleLibrary();
+
+		if (startupDesign.size())
+			LoadInBackground(startupDesign);
+
+		return true;
+	}
+
+	bool OnUserUpdate(float fElapsedTime) override
+	{
+		profiler.endFrame();
+		Profiler::Timer frameTimer(profiler, Profiler::INPUT);
+
+		// Background saves and loads redraw their progress every frame and once more when they are done.
+		finishLoad();
+		reloadChangedModules();
+
+		if (loading || saving)
+			redrawRequired = true;
+		else if (savingDesign.size())
+		{
+			savingDesign.clear();
+			redrawRequired = true;
+		}
+
+		if (GetKey(olc::TAB).bReleased)
+		{
+			catalogOpen = !catalogOpen;
+			catalogSearch.clear();
+			catalogSelection = 0;
+			redrawRequired = true;
+		}
+
+		// The catalog takes over the keyboard while it is open.
+		if (catalogOpen)
+		{
+			updateCatalogBrowser();
+
+			if (redrawRequired)
+			{
+				Clear(olc::BLACK);
+				DrawCatalog();
+				redrawRequired = false;
+			}
+
+			return !(GetKey(olc::ESCAPE).bPressed);
+		}
+
+		if (GetKey(olc::P).bReleased)
+		{
+			if (!simulationPaused)
+				simulationPaused = true;
+			else
+				simulationPaused = false;
+
+			redrawRequired = true;
+		}
+
+		if (GetKey(olc::I).bReleased)
+		{
+			if (!showInfo)
+				showInfo = true;
+			else
+				showInfo = false;
+
+			redrawRequired = true;
+		}
+
+		if (GetKey(olc::Key::H).bReleased)
+		{
+			if (GetKey(olc::SHIFT).bHeld)
+				resetToggles();
+			else
+				showActivity = !showActivity;
+
+			redrawRequired = true;
+		}
+
+		if (GetKey(olc::Key::E).bReleased)
+			ExportActivity("saves/" + currentDesign + "_activity.csv");
+
+		if (GetKey(olc::Key::G).bReleased)
+		{
+			if (GetKey(olc::SHIFT).bHeld)
+				ExportProfile("saves/" + currentDesign + "_profile.csv");
+			else
+				profiler.enabled = !profiler.enabled;
+
+			redrawRequired = true;
+		}
+
+		// The panel shows every frame while it is open.
+		if (profiler.enabled)
+			redrawRequired = true;
+
+		if (GetKey(olc::Key::F).bReleased)
+			fastForward(fastForwardCycles);
+
+		if (GetKey(olc::Key::K).bReleased)
+		{
+			lockstepMode = !lockstepMode;
+
+			if (lockstepMode && stepToInstructionBoundary())
+				syncEmulatorFromMachine();
+
+			emulatorStatus = lockstepMode ? "LOCKSTEP" : "";
+			redrawRequired = true;
+		}
+
+		bool freeRunning = !lockstepMode && clockSpeed == 1 && !simulationPaused;
+
+		{
+			Profiler::Timer timer(profiler, Profiler::CLOCK);
+
+			if (lockstepMode && !simulationPaused)
+				lockstepInstruction();
+			else if (freeRunning)
+				freeRunClock();
+			else
+				simulateClock();
+		}
+
+		if (GetKey(olc::Key::T).bReleased)
+		{
+			tiledRendering = !tiledRendering;
+			redrawRequired = true;
+		}
+
+		if (GetKey(olc::Key::UP).bReleased)
+		{
+			clockSpeed++;
+			redrawRequired = true;
+		}
+
+		if (GetKey(olc::Key::DOWN).bReleased)
+		{
+			if (clockSpeed > 0)
+			{
+				clockSpeed--;
+				redrawRequired = true;
+			}
+		}
+
+
+		if (GetMouseWheel() > 0)
+		{
+			pz.ZoomIn(1.1f);
+			redrawRequired = true;
+		}
+
+		if (GetMouseWheel() < 0)
+		{
+			pz.ZoomOut(0.9f);
+			redrawRequired = true;
+		}
+
+		if (GetKey(olc::Z).bReleased)
+		{
+			pz.SetScale({ 1.0f, 1.0f });
+			redrawRequired = true;
+		}
+
+		if (GetKey(olc::Q).bHeld)
+		{
+			pz.ZoomOut(1000);
+			redrawRequired = true;
+		}
+
+		// Pan
+		if (GetMouse(2).bHeld)
+			redrawRequired = true;
+
+		if (GetMouse(2).bPressed)
+			pz.StartPan();
+
+		if (GetMouse(2).bReleased)
+			pz.StopPan();
+
+		// Draw mouse guides
+		if (GetKey(olc::X).bHeld || GetKey(olc::X).bReleased)
+		{
+			redrawRequired = true;
+		}
+
+
+		pz.Update(fElapsedTime);
+
+		if (GetKey(olc::Key::R).bReleased)
+		{
+			programRAM();
+			updateSimulation = true;
+			redrawRequired = true;
+		}
+
+		// A free running clock has had its passes.
+		if (!freeRunning)
+		{
+			Profiler::Timer timer(profiler, Profiler::CLOCK);
+			runSimulation();
+		}
+
+		//---------------------
+
+		size_t componentCount = components.size();
+		size_t terminalCount = terminals.size();
+		size_t connectionCount = connections.size();
+
+		// Nothing is edited or saved while a load is running, it would go to the journal of the design being replaced.
+		bool editable = !loading;
+
+		if (GetMouse(0).bReleased && editable)
+		{
+			if (!placingModule)
+			{
+				components.push_back({ lastComponentId, inventoryComponents[activeInventoryComponent], GetWorldMouse(), placementWidth(inventoryComponents[activeInventoryComponent]) });
+
+				if (inventoryComponents[activeInventoryComponent] == "TRANSISTOR")
+				{
+					terminals.push_back({ lastTerminalId, GetWorldMouse() + olc::vi2d(25, -25), false, "transCollector", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, GetWorldMouse() + olc::vi2d(-25, 0), false, "transBase", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, GetWorldMouse() + olc::vi2d(25, 25), false, "transEmitter", lastComponentId });
+					lastTerminalId++;
+				}
+
+				if (inventoryComponents[activeInventoryComponent] == "GATED LATCH")
+				{
+					terminals.push_back({ lastTerminalId, GetWorldMouse() + olc::vi2d(-25, -25), false, "gatedIn", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, GetWorldMouse() + olc::vi2d(-25, 25), false, "gatedWriteEnable", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, GetWorldMouse() + olc::vi2d(25, 0), false, "gatedOut", lastComponentId });
+					lastTerminalId++;
+				}
+
+				if (inventoryComponents[activeInventoryComponent] == "ALU")
+				{
+					int bits = placementWidth("ALU");
+					float margin = 27.3;
+					int width = aluSize(bits);
+					olc::vf2d worldMouse = GetWorldMouse();
+
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(width, width / 2), false, "aluSub", lastComponentId });
+					lastTerminalId++;
+
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(width, width / 6), false, "aluZeroFlagOut", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(width, width / 4), false, "aluCarryFlagOut", lastComponentId });
+					lastTerminalId++;
+
+					for (int bit = 0; bit < bits; bit++)
+					{
+						terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(margin * 2 + bit * margin, 0), false, "aluInA" + std::to_string(bit + 1), lastComponentId });
+						lastTerminalId++;
+					}
+
+					for (int bit = 0; bit < bits; bit++)
+					{
+						terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(margin * 2 + bit * margin, margin * 3 + margin * bits), false, "aluInB" + std::to_string(bit + 1), lastComponentId });
+						lastTerminalId++;
+					}
+
+					for (int bit = 0; bit < bits; bit++)
+					{
+						terminals.push_back({ lastTerminalId, worldMouse + olc::vi2d(0, margin * 2 + bit * margin), false, "aluOut" + std::to_string(bit + 1), lastComponentId });
+						lastTerminalId++;
+					}
+				}
+
+				if (inventoryComponents[activeInventoryComponent] == "RAM")
+				{
+					float scale = pz.GetScale().x;
+					int margin = 20 * scale;
+					int ramHeight = 415 * scale;
+					int ramWidth = 215 * scale;
+					olc::vf2d worldMouse = GetWorldMouse();
+
+					// Input Terminals
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 0 * margin, 0), false, "ramIn1", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 1.25 * margin, 0), false, "ramIn2", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 2.5 * margin, 0), false, "ramIn3", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 3.75 * margin, 0), false, "ramIn4", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 5 * margin, 0), false, "ramIn5", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 6.25 * margin, 0), false, "ramIn6", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 7.5 * margin, 0), false, "ramIn7", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 8.75 * margin, 0), false, "ramIn8", lastComponentId });
+					lastTerminalId++;
+
+					// Output Terminals
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 0 * margin, ramHeight), false, "ramOut1", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 1.25 * margin, ramHeight), false, "ramOut2", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 2.5 * margin, ramHeight), false, "ramOut3", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 3.75 * margin, ramHeight), false, "ramOut4", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 5 * margin, ramHeight), false, "ramOut5", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 6.25 * margin, ramHeight), false, "ramOut6", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 7.5 * margin, ramHeight), false, "ramOut7", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(margin * 1 + 8.75 * margin, ramHeight), false, "ramOut8", lastComponentId });
+					lastTerminalId++;
+
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(0, ramHeight / 2 + 20), false, "ramWriteEnable", lastComponentId });
+					lastTerminalId++;
+
+					// Address Terminals, most significant at the top
+					int addressBits = placementWidth("RAM");
+					float addressSpacing = addressBits <= 8 ? 40 : 20;
+
+					for (int bit = addressBits; bit >= 1; bit--)
+					{
+						terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(ramWidth, ramHeight / 2 + (addressBits / 2.0f - bit + 0.5f) * addressSpacing), false, "ramAddressIn" + std::to_string(bit), lastComponentId });
+						lastTerminalId++;
+					}
+
+					configureRAM(addressBits);
+				}
+
+				if (inventoryComponents[activeInventoryComponent] == "COUNTER")
+				{
+					int bits = placementWidth("COUNTER");
+					float scale = pz.GetScale().x;
+					int counterHeight = 50 * scale;
+					float bitPadding = 25 * scale;
+					olc::vf2d worldMouse = GetWorldMouse();
+
+					// Counter In, most significant on the left
+					for (int bit = bits; bit >= 1; bit--)
+					{
+						terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * (bits - bit + 1) - 4, 0), false, "counterIn" + std::to_string(bit), lastComponentId });
+						lastTerminalId++;
+					}
+
+					// Counter Out
+					for (int bit = bits; bit >= 1; bit--)
+					{
+						terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * (bits - bit + 1) - 4, counterHeight), false, "counterOut" + std::to_string(bit), lastComponentId });
+						lastTerminalId++;
+					}
+
+					// Counter Clock
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(0, 0 + bitPadding / 3), false, "counterClock", lastComponentId });
+					lastTerminalId++;
+
+					// Jump (Counter Write Enable)
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(0, counterHeight / 2), false, "counterWriteEnable", lastComponentId });
+					lastTerminalId++;
+
+					// Count Enable (increment)
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(0, counterHeight - bitPadding / 3), false, "counterCountEnable", lastComponentId });
+					lastTerminalId++;
+				}
+
+				if (inventoryComponents[activeInventoryComponent] == "MICROCOUNTER")
+				{
+					float scale = pz.GetScale().x;
+					int counterWidth = 120 * scale;
+					int counterHeight = 50 * scale;
+					float bitPadding = 25 * scale;
+					olc::vf2d worldMouse = GetWorldMouse();
+
+					// Reset
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(0, counterHeight / 2), false, "microcounterReset", lastComponentId });
+					lastTerminalId++;
+
+					// Counter In
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 2 - 29, 0), false, "microcounterIn3", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 3 - 29, 0), false, "microcounterIn2", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 4 - 29, 0), false, "microcounterIn1", lastComponentId });
+					lastTerminalId++;
+
+					// Counter Out
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 2 - 29, counterHeight), false, "microcounterOut3", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 3 - 29, counterHeight), false, "microcounterOut2", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 4 - 29, counterHeight), false, "microcounterOut1", lastComponentId });
+					lastTerminalId++;
+				}
+
+				if (inventoryComponents[activeInventoryComponent] == "IR")
+				{
+					float scale = pz.GetScale().x;
+					int counterWidth = 240 * scale;
+					int counterHeight = 50 * scale;
+					float bitPadding = 25 * scale;
+					float xOffset = -6 * scale;
+					olc::vf2d worldMouse = GetWorldMouse();
+
+					// IR In
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding - xOffset, 0), false, "IRIn8", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 2 - xOffset, 0), false, "IRIn7", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 3 - xOffset, 0), false, "IRIn6", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 4 - xOffset, 0), false, "IRIn5", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 5 - xOffset, 0), false, "IRIn4", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 6 - xOffset, 0), false, "IRIn3", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 7 - xOffset, 0), false, "IRIn2", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 8 - xOffset, 0), false, "IRIn1", lastComponentId });
+					lastTerminalId++;
+
+					// IR Decode Out
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding - xOffset, counterHeight), false, "IRDecodeOut8", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 2 - xOffset, counterHeight), false, "IRDecodeOut7", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 3 - xOffset, counterHeight), false, "IRDecodeOut6", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 4 - xOffset, counterHeight), false, "IRDecodeOut5", lastComponentId });
+					lastTerminalId++;
+
+					// IR Out
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 5- xOffset, counterHeight), false, "IROut4", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 6 - xOffset, counterHeight), false, "IROut3", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 7 - xOffset, counterHeight), false, "IROut2", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 8 - xOffset, counterHeight), false, "IROut1", lastComponentId });
+					lastTerminalId++;
+
+					// IR Write Enable
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(0, counterHeight / 2), false, "IRWriteEnable", lastComponentId });
+					lastTerminalId++;
+
+					
+				}
+
+				if (inventoryComponents[activeInventoryComponent] == "DECODER")
+				{
+					float scale = pz.GetScale().x;
+					int width = 300 * scale;
+					int height = 60 * scale;
+					float bitPadding = 25 * scale;
+					float topBitPadding = 50 * scale;
+					float xOffset = 25 * scale;
+					olc::vf2d worldMouse = GetWorldMouse();
+
+					// Decoder In
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(topBitPadding - xOffset, 0), false, "decoderIn1", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(topBitPadding * 2 - xOffset, 0), false, "decoderIn2", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(topBitPadding * 3 - xOffset, 0), false, "decoderIn3", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(topBitPadding * 4 - xOffset, 0), false, "decoderIn4", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(topBitPadding * 5 - xOffset, 0), false, "decoderIn5", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(topBitPadding * 6 - xOffset, 0), false, "decoderIn6", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(topBitPadding * 7 - xOffset, 0), false, "decoderIn7", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(topBitPadding * 8 - xOffset, 0), false, "decoderIn8", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(topBitPadding * 9 - xOffset, 0), false, "decoderIn9", lastComponentId });
+					lastTerminalId++;
+
+					// Decoder Out
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding, height), false, "decoderOut1", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 2, height), false, "decoderOut2", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 3, height), false, "decoderOut3", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 4, height), false, "decoderOut4", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 5, height), false, "decoderOut5", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 6, height), false, "decoderOut6", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 7, height), false, "decoderOut7", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 8, height), false, "decoderOut8", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 9, height), false, "decoderOut9", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 10, height), false, "decoderOut10", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 11, height), false, "decoderOut11", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 12, height), false, "decoderOut12", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 13, height), false, "decoderOut13", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 14, height), false, "decoderOut14", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 15, height), false, "decoderOut15", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 16, height), false, "decoderOut16", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 17, height), false, "decoderOut17", lastComponentId });
+					lastTerminalId++;
+				}
+
+				if (inventoryComponents[activeInventoryComponent] == "FLAGSREG")
+				{
+					float scale = pz.GetScale().x;
+					int width = 75 * scale;
+					int height = 60 * scale;
+					float bitPadding = 25 * scale;
+					float xOffset = 0 * scale;
+					olc::vf2d worldMouse = GetWorldMouse();
+
+					// Flags Write Enable
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(width, height / 2), false, "flagsRegWriteEnable", lastComponentId });
+					lastTerminalId++;
+
+					// Flags Reg In
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding - xOffset, 0), false, "flagsRegIn1", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 2 - xOffset, 0), false, "flagsRegIn2", lastComponentId });
+					lastTerminalId++;
+
+					// Flags Reg Out
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding - xOffset, height), false, "flagsRegOut1", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 2 - xOffset, height), false, "flagsRegOut2", lastComponentId });
+					lastTerminalId++;
+				}
+
+				if (inventoryComponents[activeInventoryComponent] == "DISPLAY")
+				{
+					float scale = pz.GetScale().x;
+					int width = 405 * scale;
+					int height = 180 * scale;
+					float bitPadding = 17 * scale;
+					olc::vf2d worldMouse = GetWorldMouse();
+
+					// Display In
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding, 0), false, "displayIn8", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 2, 0), false, "displayIn7", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 3, 0), false, "displayIn6", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 4, 0), false, "displayIn5", lastComponentId });
 					lastTerminalId++;
 					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 5, 0), false, "displayIn4", lastComponentId });
 					lastTerminalId++;
 					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 6, 0), false, "displayIn3", lastComponentId });
 					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 7, 0), false, "displayIn2", lastComponentId });
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 7, 0), false, "displayIn2", lastComponentId });
+					lastTerminalId++;
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 8, 0), false, "displayIn1", lastComponentId });
+					lastTerminalId++;
+
+					// Display Write Enable
+					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(width, height / 2), false, "displayWriteEnable", lastComponentId });
+					lastTerminalId++;
+				}
+
+				if (inventoryComponents[activeInventoryComponent] == "BUFFER")
+				{
+					terminals.push_back({ lastTerminalId, GetWorldMouse(), false, "buffer", lastComponentId });
+					lastTerminalId++;
+				}
+
+				if (inventoryComponents[activeInventoryComponent] == "BUSTERM")
+				{
+					std::string termType = "";
+					if (currentBusColumn == 1)
+						termType = "bus1";
+					else if (currentBusColumn == 2)
+						termType = "bus2";
+					else if (currentBusColumn == 3)
+						termType = "bus3";
+					else if (currentBusColumn == 4)
+						termType = "bus4";
+					else if (currentBusColumn == 5)
+						termType = "bus5";
+					else if (currentBusColumn == 6)
+						termType = "bus6";
+					else if (currentBusColumn == 7)
+						termType = "bus7";
+					else if (currentBusColumn == 8)
+						termType = "bus8";
+					
+					terminals.push_back({ lastTerminalId, GetWorldMouse(), false, termType, lastComponentId });
+					lastTerminalId++;
+				}
+
+				if (inventoryComponents[activeInventoryComponent] == "LED")
+				{
+					terminals.push_back({ lastTerminalId, GetWorldMouse(), false, "buffer", lastComponentId });
 					lastTerminalId++;
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(bitPadding * 8, 0), false, "displayIn1", lastComponentId });
+				}
+
+				lastComponentId++;
+			}
+			else
+			{
+				if (GetKey(olc::SHIFT).bHeld)
+					PlaceFlattenedModule(inventoryModules[activeInventoryModule]);
+				else
+					PlaceModule(inventoryModules[activeInventoryModule]);
+			}
+
+			journalAppended(componentCount, terminalCount, connectionCount);
+			indexAppended(componentCount, terminalCount, connectionCount);
+			redrawRequired = true;
+		}
+
+		if (GetKey(olc::DEL).bReleased && editable)
+		{
+			deleteClosest();
+			redrawRequired = true;
+		}
+
+		// Edits are already in the journal, S only refreshes the snapshot in the background. A design that was
+		// never saved gets its first container here.
+		if (GetKey(olc::S).bReleased && editable)
+		{
+			if (journalDesign.empty())
+				Save();
+			else
+				compactJournal();
+		}
+
+		if (GetKey(olc::L).bReleased)
+		{
+			if (journalDesign.empty())
+				Save();
+
+			LoadInBackground();
+			redrawRequired = true;
+		}
+
+		componentCount = components.size();
+		terminalCount = terminals.size();
+		connectionCount = connections.size();
+
+		if (GetMouse(1).bReleased && editable)
+		{
+			bool needsNotOut = false;
+			int transistorId = 0;
+
+			if (!selectedTerminalA)
+			{
+				double smallestDistance = 0.00;
+				int closestTerminalId = 0;
+				olc::vi2d closestTerminalPos;
+
+				for (auto terminal : terminals)
+				{
+					double distance = CalculateDistance(terminal.pos, GetWorldMouse());
+
+					if (distance < smallestDistance || smallestDistance == 0.00)
+					{
+						if (terminal.type == "sourceStart" || terminal.type == "transEmitter" || terminal.type == "transNotOut" || terminal.type == "buffer" || terminal.type == "gatedOut" || terminal.type == "clock" || ("bus1" <= terminal.type && terminal.type <= "bus8") || isBehaviouralOutput(terminal.type))
+						{
+							smallestDistance = distance;
+							closestTerminalId = terminal.id;
+							closestTerminalPos = terminal.pos;
+						}
+					}
+				}
+
+				if (smallestDistance < 10.00)
+				{
+					selectedTerminalA = closestTerminalId;
+					selectedTerminalAPos = closestTerminalPos;
+				}
+			}
+			else
+			{
+				double smallestDistance = 0.00;
+				int closestTerminalId = 0;
+				olc::vi2d closestTerminalPos;
+
+				for (auto terminal : terminals)
+				{
+					double distance = CalculateDistance(terminal.pos, GetWorldMouse());
+
+					if (distance < smallestDistance || smallestDistance == 0.00)
+					{
+						if (terminal.type == "transCollector" || terminal.type == "transBase" || terminal.type == "sourceEnd" || terminal.type == "buffer" || terminal.type == "gatedIn" || terminal.type == "gatedWriteEnable" || terminalBit(terminal.type, "aluInA") || terminalBit(terminal.type, "aluInB") || ("ramIn1" <= terminal.type && terminal.type <= "ramIn8") || terminalBit(terminal.type, "ramAddressIn") || terminal.type == "ramWriteEnable" || ("bus1" <= terminal.type && terminal.type <= "bus8") || terminalBit(terminal.type, "counterIn") || terminal.type == "counterClock" || terminal.type == "counterWriteEnable" || terminal.type == "counterCountEnable" || ("microcounterIn1" <= terminal.type && terminal.type <= "microcounterIn3") || ("IRIn1" <= terminal.type && terminal.type <= "IRIn8") || terminal.type == "IRWriteEnable" || ("displayIn1" <= terminal.type && terminal.type <= "displayIn8") || terminal.type == "displayWriteEnable" || ("decoderIn1" <= terminal.type && terminal.type <= "decoderIn9") || terminal.type == "clockHalt" || terminal.type == "aluSub" || ("flagsRegIn1" <= terminal.type && terminal.type <= "flagsRegIn2") || terminal.type == "flagsRegWriteEnable" || terminal.type == "microcounterReset" || terminal.type == "moduleIn")
+						{
+							smallestDistance = distance;
+							closestTerminalId = terminal.id;
+							closestTerminalPos = terminal.pos;
+						}
+
+						if (terminal.type == "transCollector")
+						{
+							needsNotOut = true;
+							transistorId = terminal.componentId;
+						}
+						else
+						{
+							needsNotOut = false;
+							transistorId = 0;
+						}
+					}
+				}
+
+
+				if (smallestDistance < 10.00 && selectedTerminalA != closestTerminalId)
+				{
+					selectedTerminalB = closestTerminalId;
+					selectedTerminalBPos = closestTerminalPos;
+				}
+
+			}
+
+
+			if (selectedTerminalA && selectedTerminalB)
+			{
+				int notOutTerminalId = 0;
+
+				if (needsNotOut)
+					notOutTerminalId = lastTerminalId;
+
+				Connection newConnection = {
+					lastConnectionId,
+					selectedTerminalA,
+					selectedTerminalB,
+					selectedTerminalAPos,
+					selectedTerminalBPos,
+					notOutTerminalId,
+				};
+				lastConnectionId++;
+				connections.push_back(newConnection);
+
+				if (needsNotOut)
+				{
+					olc::vi2d notOutPos = calculateNotOut(selectedTerminalAPos, selectedTerminalBPos);
+					terminals.push_back({ lastTerminalId, notOutPos, false, "transNotOut", transistorId });
 					lastTerminalId++;
+				}
+
+				journalAppended(componentCount, terminalCount, connectionCount);
+				indexAppended(componentCount, terminalCount, connectionCount);
+				updateSourceConnections();
+				updateSimulation = true;
+
+				selectedTerminalA = 0;
+				selectedTerminalB = 0;
+				selectedTerminalAPos = olc::vi2d(0, 0);
+				selectedTerminalBPos = olc::vi2d(0, 0);
+			}
+
+			redrawRequired = true;
+		}
+
+		if (GetKey(olc::Key::SPACE).bReleased)
+		{
+			if (activeInventoryComponent < (int)inventoryComponents.size() - 1)
+				activeInventoryComponent++;
+			else
+				activeInventoryComponent = 0;
+
+			redrawRequired = true;
+		}
+
+		if (GetKey(olc::Key::A).bReleased)
+		{
+			if (selectedRamAddress < (int)ramContents.size() - 1)
+				selectedRamAddress++;
+			else
+				selectedRamAddress = 0;
+
+			updateSimulation = true;
+			redrawRequired = true;
+		}
+
+		if (GetKey(olc::Key::N).bReleased)
+		{
+			if (activeInventoryModule < (int)inventoryModules.size() - 1)
+				activeInventoryModule++;
+			else
+				activeInventoryModule = 0;
+
+			redrawRequired = true;
+		}
+
+		if (GetKey(olc::Key::M).bReleased)
+		{
+			if (!placingModule)
+				placingModule = true;
+			else
+				placingModule = false;
+
+			redrawRequired = true;
+		}
+
+		if (placingModule)
+			redrawRequired = true;
+
+		if (GetKey(olc::Key::W).bReleased)
+		{
+			if (activeWidthOption < 2)
+				activeWidthOption++;
+			else
+				activeWidthOption = 0;
+
+			redrawRequired = true;
+		}
+
+		if (GetKey(olc::Key::B).bReleased)
+		{
+			if (currentBusColumn < 8)
+				currentBusColumn++;
+			else
+				currentBusColumn = 1;
+
+			redrawRequired = true;
+		}
+
+		olc::vi2d sourceScreenPosition;
+		pz.WorldToScreen({ 0, 0 }, sourceScreenPosition);
+
+		olc::vi2d clockScreenPosition;
+		pz.WorldToScreen({ -200, 0 }, clockScreenPosition);
+
+		// Frames drawn and clock cycles run over the last second, for the corner of the screen.
+		auto now = std::chrono::steady_clock::now();
+		double rateWindow = std::chrono::duration<double>(now - rateWindowStart).count();
+
+		if (rateWindow >= 1)
+		{
+			measuredFps = rateWindowFrames / rateWindow;
+			measuredHz = (clockCycles - rateWindowCycles) / rateWindow;
+			rateWindowStart = now;
+			rateWindowFrames = 0;
+			rateWindowCycles = clockCycles;
+			redrawRequired = true;
+		}
+
+		// However often something changes, the screen is redrawn at most targetFps times a second.
+		if (redrawRequired && now - lastRedraw >= std::chrono::microseconds(1000000 / targetFps))
+		{
+			Profiler::Timer timer(profiler, Profiler::DRAW);
+			profiler.frameDrawn = true;
+			lastRedraw = now;
+			rateWindowFrames++;
+			findVisible();
+			DrawStaticLayer();
+
+			if (!componentBuilderMode)
+				DrawSource(sourceScreenPosition);
+			else
+				DrawCircle(sourceScreenPosition, 2, olc::DARK_GREY);
+
+			DrawClock(clockScreenPosition);
+
+			if (GetKey(olc::X).bHeld)
+			{
+				DrawLine({ GetMouseX(), 0 }, { GetMouseX(), ScreenHeight() }, { 64, 64, 64 }, 0xF0F0F0F0);
+				DrawLine({ 0, GetMouseY() }, { ScreenWidth(), GetMouseY() }, { 64, 64, 64 }, 0xF0F0F0F0);
+			}
+
+			DrawCircuit(false);
+
+			if (placingModule)
+			{
+				const ModuleDefinition* definition = moduleDefinition(inventoryModules[activeInventoryModule]);
+				olc::vi2d ghostMin;
+				olc::vi2d ghostMax;
+				pz.WorldToScreen(definition->boundsMin + GetWorldMouse(), ghostMin);
+				pz.WorldToScreen(definition->boundsMax + GetWorldMouse(), ghostMax);
+
+				DrawLine(ghostMin, { ghostMax.x, ghostMin.y }, olc::GREY, 0xF0F0F0F0);
+				DrawLine(ghostMin, { ghostMin.x, ghostMax.y }, olc::GREY, 0xF0F0F0F0);
+				DrawLine({ ghostMax.x, ghostMin.y }, ghostMax, olc::GREY, 0xF0F0F0F0);
+				DrawLine({ ghostMin.x, ghostMax.y }, ghostMax, olc::GREY, 0xF0F0F0F0);
+			}
+
+			DrawStrings();
+			redrawRequired = false;
+		}
+
+		return !(GetKey(olc::ESCAPE).bPressed);
+	}
+
+	// viscom --headless <save timestamp> <clock cycles> [--interpret | --no-gates | --no-fold]
+	int RunHeadless(std::string saveTimestamp, long long cycles, std::string option)
+	{
+		Load(saveTimestamp);
+
+		if (terminals.empty())
+		{
+			std::cout << "Could not load save " << saveTimestamp << std::endl;
+			return 1;
+		}
+
+		netlist = buildNetlist();
+		int transistorLevelNodes = netlist.countEvaluated();
+
+		if (option != "--no-fold")
+		{
+			netlist.propagateConstants();
+			netlist.pruneDeadLogic();
+
+			int constantTerminals = 0;
+			for (int node : netlist.terminalNodes)
+				if (netlist.nodes[node].kind == Netlist::NODE_CONSTANT)
+					constantTerminals++;
+
+			std::cout << "Constants: " << netlist.foldedOn + netlist.foldedOff << " nodes folded (" << netlist.foldedOn << " on, " << netlist.foldedOff << " off) covering " << constantTerminals << " terminals, " << netlist.deadNodes << " dead nodes pruned, " << netlist.countEvaluated() << " of " << transistorLevelNodes << " nodes left per pass" << std::endl;
+		}
+
+		if (option != "--no-gates")
+		{
+			netlist.recognizeGates();
+
+			std::cout << "Gates: " << netlist.countEvaluated() << " nodes evaluated per pass instead of " << transistorLevelNodes << " (" << netlist.countEvaluated(Netlist::NODE_NOT) << " NOT, " << netlist.countEvaluated(Netlist::NODE_AND) << " AND, " << netlist.countEvaluated(Netlist::NODE_NAND) << " NAND, " << netlist.countEvaluated(Netlist::NODE_XOR) << " XOR, " << netlist.countEvaluated(Netlist::NODE_WIRE) << " wires)" << std::endl;
+		}
+
+		if (option != "--interpret")
+		{
+			std::string error;
+
+			if (!compiledNetlist.load(netlist, error))
+				std::cout << "Falling back to the interpreter, " << error << std::endl;
+		}
+
+		std::cout << (compiledNetlist.ready() ? "Compiled" : "Interpreted") << " netlist: " << terminals.size() << " terminals, " << netlist.nodes.size() << " nodes" << std::endl;
+
+		if (compiledNetlist.ready() && netlist.gates.size())
+		{
+			Netlist transistorLevel = netlist;
+			transistorLevel.gates.clear();
+			transistorLevel.live.clear();
+
+			CompiledNetlist transistorLevelCompiled;
+			std::string error;
+
+			if (transistorLevelCompiled.load(transistorLevel, error))
+			{
+				double gateTime = timeSettle(compiledNetlist);
+				double transistorTime = timeSettle(transistorLevelCompiled);
+				std::cout << "Settle pass: " << gateTime << " ns with gates, " << transistorTime << " ns transistor level, " << transistorTime / gateTime << "x" << std::endl;
+			}
+		}
+
+		updateSimulation = true;
+		for (int pass = 0; updateSimulation && pass < 100; pass++)
+			simulatePass();
+
+		auto start = std::chrono::steady_clock::now();
+		long long startCycles = clockCycles;
+
+		while (clockCycles - startCycles < cycles && stepClock() && stepClock())
+		{
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		long long cyclesRun = clockCycles - startCycles;
+
+		// Bring the terminals the gate pass skips up to date as well.
+		if (compiledNetlist.ready())
+		{
+			compiledNetlist.visual(compiledNetlist.values.data());
+
+			for (int i = 0; i < (int)terminals.size(); i++)
+				if (terminals[i].id != 1)
+					terminals[i].state = compiledNetlist.values[netlist.terminalNodes[i]];
+		}
+
+		std::cout << cyclesRun << " cycles in " << seconds << " s, " << (seconds > 0 ? cyclesRun / seconds : 0) << " Hz" << std::endl;
+		std::cout << "A " << latchValue(findRegisterLatches("aluInA", 8), true) << "  B " << latchValue(findRegisterLatches("aluInB", 8), true) << "  PC " << counterValue << "  OUT " << registerContents(displayContents, true) << std::endl;
+
+		return 0;
+	}
+
+	// Whole argument as a non negative number of clock cycles.
+	static bool parseCycles(const std::string& text, long long& cycles)
+	{
+		auto result = std::from_chars(text.data(), text.data() + text.size(), cycles);
+		return result.ec == std::errc() && result.ptr == text.data() + text.size() && cycles >= 0;
+	}
+
+	// viscom --activity <save timestamp> <clock cycles> [csv path]
+	int RunActivity(std::string saveTimestamp, long long cycles, std::string path)
+	{
+		if (int result = RunHeadless(saveTimestamp, cycles, ""))
+			return result;
+
+		return ExportActivity(path.size() ? path : "saves/" + saveTimestamp + "_activity.csv") ? 0 : 1;
+	}
+
+	// viscom --benchmark-load
+	// Loads every text save in saves/ from its text files and from a container, checks both give the same design and
+	// compares the time spent. Saves without a container get a temporary one.
+	int BenchmarkLoad()
+	{
+		std::vector<std::string> timestamps;
+		const std::string suffix = "_terminals.txt";
+
+		// olcPixelGameEngine.h already brings in <filesystem> as _gfs.
+		for (auto& entry : _gfs::directory_iterator("saves"))
+		{
+			std::string name = entry.path().filename().string();
+
+			if (name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+				timestamps.push_back(name.substr(0, name.size() - suffix.size()));
+		}
+
+		std::sort(timestamps.begin(), timestamps.end());
+
+		auto fileSize = [](std::string path) { return _gfs::exists(path) ? (size_t)_gfs::file_size(path) : 0; };
+
+		double textSeconds = 0;
+		double containerSeconds = 0;
+		size_t textBytes = 0;
+		size_t containerBytes = 0;
+		int mismatches = 0;
+
+		for (auto& timestamp : timestamps)
+		{
+			std::string filepath = "saves/" + timestamp + "_";
+			std::string containerPath = "saves/" + timestamp + ".vsave";
+
+			auto start = std::chrono::steady_clock::now();
+			LoadText(filepath);
+			updateSourceConnections();
+			textSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			for (std::string file : { "globals.txt", "components.txt", "connections.txt", "terminals.txt" })
+				textBytes += fileSize(filepath + file);
+
+			std::vector<Component> textComponents = components;
+			std::vector<Terminal> textTerminals = terminals;
+			std::vector<Connection> textConnections = connections;
+			std::vector<int> textSources;
+			for (auto connection : sourceConnections)
+				textSources.push_back(int(connection - connections.data()));
+
+			bool temporary = !_gfs::exists(containerPath);
+			if (temporary)
+				SaveContainer(containerPath, timestamp);
+
+			containerBytes += fileSize(containerPath);
+
+			start = std::chrono::steady_clock::now();
+			bool loaded = LoadContainer(containerPath);
+			containerSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			if (temporary)
+				std::remove(containerPath.c_str());
+
+			bool same = loaded && components.size() == textComponents.size() && terminals.size() == textTerminals.size() && connections.size() == textConnections.size() && sourceConnections.size() == textSources.size();
+
+			for (size_t i = 0; same && i < components.size(); i++)
+				same = components[i].id == textComponents[i].id && components[i].type == textComponents[i].type && components[i].pos == textComponents[i].pos && components[i].width == textComponents[i].width;
+
+			for (size_t i = 0; same && i < terminals.size(); i++)
+				same = terminals[i].id == textTerminals[i].id && terminals[i].pos == textTerminals[i].pos && terminals[i].type == textTerminals[i].type && terminals[i].componentId == textTerminals[i].componentId;
+
+			for (size_t i = 0; same && i < connections.size(); i++)
+				same = connections[i].id == textConnections[i].id && connections[i].terminalA == textConnections[i].terminalA && connections[i].terminalB == textConnections[i].terminalB && connections[i].terminalAPos == textConnections[i].terminalAPos && connections[i].terminalBPos == textConnections[i].terminalBPos && connections[i].notOutTerminal == textConnections[i].notOutTerminal;
+
+			for (size_t i = 0; same && i < sourceConnections.size(); i++)
+				same = sourceConnections[i] - connections.data() == textSources[i];
+
+			if (!same)
+			{
+				std::cout << "Container load of " << timestamp << " differs from the text files" << std::endl;
+				mismatches++;
+			}
+		}
+
+		std::cout << timestamps.size() << " saves, " << mismatches << " mismatches" << std::endl;
+		std::cout << "Text:      " << textBytes / 1e6 << " MB in " << textSeconds * 1000 << " ms, " << textBytes / 1e6 / textSeconds << " MB/s" << std::endl;
+		std::cout << "Container: " << containerBytes / 1e6 << " MB in " << containerSeconds * 1000 << " ms, " << containerBytes / 1e6 / containerSeconds << " MB/s, " << textSeconds / containerSeconds << "x faster" << std::endl;
+
+		return mismatches ? 1 : 0;
+	}
+
+	// viscom --benchmark-parse
+	// Reads every text save and module file in saves/, typecharSaves/ and modules/ with CsvReader, mapping included.
+	int BenchmarkParse()
+	{
+		std::vector<std::string> paths;
+
+		for (std::string folder : { "saves", "typecharSaves", "modules" })
+			for (auto& entry : _gfs::directory_iterator(folder))
+				if (entry.path().extension() == ".txt" && entry.path().filename().string().find('_') != std::string::npos)
+					paths.push_back(entry.path().string());
+
+		std::sort(paths.begin(), paths.end());
+
+		size_t bytes = 0;
+		size_t records = 0;
+		int errors = 0;
+		std::vector<Component> parsedComponents;
+		std::vector<Connection> parsedConnections;
+		std::vector<Terminal> parsedTerminals;
+		auto start = std::chrono::steady_clock::now();
+
+		for (auto& path : paths)
+		{
+			MappedFile file;
+			file.open(path);
+			bytes += file.size;
+
+			CsvReader reader((const char*)file.data, file.size, path);
+			bool read = true;
+			int ids[3];
+
+			if (path.find("_globals.txt") != std::string::npos)
+				read = readGlobals(reader, ids[0], ids[1], ids[2]);
+			else if (path.find("_components.txt") != std::string::npos)
+				read = readComponents(reader, parsedComponents);
+			else if (path.find("_connections.txt") != std::string::npos)
+				read = readConnections(reader, parsedConnections);
+			else if (path.find("_terminals.txt") != std::string::npos)
+				read = readTerminals(reader, parsedTerminals);
+
+			errors += read ? 0 : 1;
+			records += parsedComponents.size() + parsedConnections.size() + parsedTerminals.size();
+			parsedComponents.clear();
+			parsedConnections.clear();
+			parsedTerminals.clear();
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << paths.size() << " files, " << records << " records, " << errors << " with errors" << std::endl;
+		std::cout << bytes / 1e6 << " MB in " << seconds * 1000 << " ms, " << bytes / 1e6 / seconds << " MB/s" << std::endl;
+
+		return errors ? 1 : 0;
+	}
+
+	// viscom --render <folder> [search] [--cycles n] [--size WxH] [--view x,y,zoom]
+	// Draws every save the search matches into <folder>/<key>.png without a window, one design after another with the
+	// canvas drawn in tiles on all cores. The whole design is fitted into the image unless --view gives the world
+	// position of its top left corner and a zoom.
+	int RenderDesigns(std::vector<std::string> arguments)
+	{
+		std::string folder = arguments[0];
+		std::string search;
+		long long cycles = 0;
+		olc::vi2d size = { 800, 450 };
+		bool fit = true;
+		olc::vf2d viewOffset;
+		float viewScale = 1;
+		char separator;
+
+		for (size_t i = 1; i < arguments.size(); i++)
+		{
+			if (arguments[i] == "--cycles" && i + 1 < arguments.size())
+			{
+				if (!parseCycles(arguments[++i], cycles))
+				{
+					std::cout << "Not a number of clock cycles: " << arguments[i] << std::endl;
+					return 1;
+				}
+			}
+			else if (arguments[i] == "--size" && i + 1 < arguments.size())
+				std::istringstream(arguments[++i]) >> size.x >> separator >> size.y;
+			else if (arguments[i] == "--view" && i + 1 < arguments.size())
+			{
+				std::istringstream(arguments[++i]) >> viewOffset.x >> separator >> viewOffset.y >> separator >> viewScale;
+				fit = false;
+			}
+			else
+				search = arguments[i];
+		}
+
+		if (size.x <= 0 || size.y <= 0 || viewScale <= 0)
+		{
+			std::cout << "The size and zoom have to be positive" << std::endl;
+			return 1;
+		}
+
+		std::vector<std::string> keys;
+		for (auto entry : searchCatalog(search))
+			if (entry->kind == "save")
+				keys.push_back(entry->key);
+
+		_gfs::create_directories(folder);
+
+		// There is only ever one engine, making another would take over the olc platform and renderer.
+		Construct(size.x, size.y, 1, 1, false);
+		pz.Create(this);
+		tiledRendering = true;
+
+		auto start = std::chrono::steady_clock::now();
+		olc::Sprite image(size.x, size.y);
+		int failed = 0;
+
+		for (auto& key : keys)
+		{
+			std::string path = folder + "/" + key + ".png";
+			std::replace(path.begin() + folder.size() + 1, path.end(), '/', '_');
+			bool rendered = RenderDesign(key, cycles, fit, viewOffset, viewScale, image) && writePng(path, image);
+
+			std::cout << (rendered ? path : "Could not render " + key) << std::endl;
+			failed += rendered ? 0 : 1;
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << keys.size() - failed << " of " << keys.size() << " saves rendered in " << seconds << " s on " << renderPool.threads.size() + 1 << " threads" << std::endl;
+
+		return failed ? 1 : 0;
+	}
+
+	// Loads a design, runs its clock and draws it into the image, which has to be the size the engine was made with.
+	bool RenderDesign(std::string key, long long cycles, bool fit, olc::vf2d offset, float scale, olc::Sprite& image)
+	{
+		Load(key);
+
+		if (components.empty() && terminals.empty())
+			return false;
+
+		updateSimulation = true;
+		for (int pass = 0; updateSimulation && pass < 100; pass++)
+			simulatePass();
+
+		for (long long cycle = 0; cycle < cycles && stepClock() && stepClock(); cycle++)
+		{
+		}
+
+		if (fit)
+		{
+			olc::vi2d low = terminals.size() ? terminals[0].pos : components[0].pos;
+			olc::vi2d high = low;
+
+			for (auto& component : components)
+			{
+				olc::vi2d componentLow, componentHigh;
+				componentBounds(component, componentLow, componentHigh);
+				low = low.min(componentLow);
+				high = high.max(componentHigh);
+			}
+
+			for (auto& terminal : terminals)
+			{
+				low = low.min(terminal.pos - olc::vi2d(10, 10));
+				high = high.max(terminal.pos + olc::vi2d(10, 10));
+			}
+
+			olc::vf2d extent = high - low + olc::vi2d(1, 1);
+			scale = std::min(image.width / extent.x, image.height / extent.y) * 0.95f;
+			offset = olc::vf2d(low + high) * 0.5f - olc::vf2d(float(image.width), float(image.height)) / (2 * scale);
+		}
+
+		pz.SetScale({ scale, scale });
+		pz.SetOffset(offset);
+
+		SetDrawTarget(&image);
+		findVisible();
+		DrawStaticLayer();
+		DrawCircuit(false);
+		return true;
+	}
+
+	// viscom --diff <before> <after> [folder]
+	// Compares two renders, or every PNG in the folder <before> with the one of the same name in <after>. Images with
+	// differing pixels are listed, and written to the folder with those pixels in magenta over a dimmed copy of before.
+	int DiffRenders(std::string before, std::string after, std::string folder)
+	{
+		std::vector<std::pair<_gfs::path, _gfs::path>> pairs;
+
+		if (_gfs::is_directory(before))
+		{
+			for (auto& entry : _gfs::directory_iterator(before))
+				if (entry.path().extension() == ".png")
+					pairs.push_back({ entry.path(), _gfs::path(after) / entry.path().filename() });
+
+			std::sort(pairs.begin(), pairs.end());
+		}
+		else
+			pairs.push_back({ before, after });
+
+		if (folder.size())
+			_gfs::create_directories(folder);
+
+		int differing = 0;
+
+		for (auto& pair : pairs)
+		{
+			std::string name = pair.first.filename().string();
+			olc::Sprite beforeImage, afterImage;
+
+			if (!_gfs::exists(pair.second) || beforeImage.LoadFromFile(pair.first.string()) != olc::OK || afterImage.LoadFromFile(pair.second.string()) != olc::OK)
+			{
+				std::cout << name << ": could not read both images" << std::endl;
+				differing++;
+				continue;
+			}
+
+			if (beforeImage.width != afterImage.width || beforeImage.height != afterImage.height)
+			{
+				std::cout << name << ": " << beforeImage.width << "x" << beforeImage.height << " against " << afterImage.width << "x" << afterImage.height << std::endl;
+				differing++;
+				continue;
+			}
+
+			olc::Sprite marked(beforeImage.width, beforeImage.height);
+			int pixels = 0;
+
+			for (size_t i = 0; i < beforeImage.pColData.size(); i++)
+			{
+				olc::Pixel pixel = beforeImage.pColData[i];
+
+				if (pixel != afterImage.pColData[i])
+				{
+					marked.pColData[i] = olc::MAGENTA;
+					pixels++;
+				}
+				else
+					marked.pColData[i] = olc::Pixel(pixel.r / 4, pixel.g / 4, pixel.b / 4);
+			}
+
+			if (!pixels)
+				continue;
+
+			differing++;
+			std::cout << name << ": " << pixels << " pixels differ" << std::endl;
+
+			if (folder.size())
+				writePng(folder + "/" + name, marked);
+		}
+
+		std::cout << differing << " of " << pairs.size() << " images differ" << std::endl;
+		return differing ? 1 : 0;
+	}
+
+	// viscom --catalog [search]
+	int ListCatalog(std::string search)
+	{
+		auto start = std::chrono::steady_clock::now();
+		std::vector<const CatalogEntry*> matches = searchCatalog(search);
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		for (auto entry : matches)
+			std::cout << std::left << std::setw(7) << entry->kind << std::setw(14) << entry->key << std::right << std::setw(6) << entry->components << " components  " << entry->name << std::endl;
+
+		std::cout << matches.size() << " of " << catalog.size() << " designs in " << milliseconds << " ms" << std::endl;
+		return 0;
+	}
+
+	// viscom --open <search>, opens the first match once the window is up.
+	bool OpenDesign(std::string search)
+	{
+		std::vector<const CatalogEntry*> matches = searchCatalog(search);
+
+		// Snapshots that are only in the history store open by their key.
+		if (matches.empty() && history.has(search))
+		{
+			startupDesign = search;
+			return true;
+		}
+
+		if (matches.empty())
+		{
+			std::cout << "Nothing in the catalog matches " << search << std::endl;
+			return false;
+		}
+
+		if (matches[0]->kind == "save")
+			startupDesign = matches[0]->key;
+		else
+			openCatalogEntry(*matches[0]);
+
+		return true;
+	}
+
+	// viscom --history [search], every snapshot in the history store with what storing it cost.
+	int ListHistory(std::string search)
+	{
+		std::lock_guard<std::mutex> lock(history.mutex);
+		history.open();
+		int listed = 0;
+
+		for (auto& snapshot : history.snapshots)
+		{
+			if (snapshot.key.find(search) == std::string::npos)
+				continue;
+
+			size_t bytes = 0;
+			for (auto& hash : snapshot.chunks)
+				bytes += history.chunks[hash].size;
+
+			std::cout << std::left << std::setw(36) << snapshot.key << std::right << std::setw(9) << bytes << " bytes" << std::setw(9) << snapshot.newBytes << " new" << std::endl;
+			listed++;
+		}
+
+		std::cout << listed << " of " << history.snapshots.size() << " snapshots, " << history.chunks.size() << " chunks" << std::endl;
+		return 0;
+	}
+
+	// viscom --import <folder>..., folds the text saves in each folder into the history store as "<folder>/<save>"
+	// and checks every one reads back the same.
+	int ImportHistory(std::vector<std::string> folders)
+	{
+		auto start = std::chrono::steady_clock::now();
+		size_t rawBytes = 0;
+		int imported = 0;
+		int mismatches = 0;
+
+		for (auto& folder : folders)
+		{
+			std::vector<std::string> keys;
+
+			for (auto& entry : _gfs::directory_iterator(folder))
+			{
+				std::string name = entry.path().filename().string();
+
+				if (name.size() > 14 && name.compare(name.size() - 14, 14, "_terminals.txt") == 0)
+					keys.push_back(name.substr(0, name.size() - 14));
+			}
+
+			// In order, so each save is stored against the one before it.
+			std::sort(keys.begin(), keys.end());
+
+			for (auto& key : keys)
+			{
+				std::string document = readTextSave(folder + "/" + key + "_");
+				std::string stored;
+
+				history.put(folder + "/" + key, document, std::atoll(key.c_str()));
+
+				if (!history.get(folder + "/" + key, stored) || stored != document)
+				{
+					std::cout << folder << "/" << key << " did not read back the same" << std::endl;
+					mismatches++;
+				}
+
+				for (std::string section : { "globals", "components", "connections", "terminals" })
+				{
+					std::error_code error;
+					std::string path = folder + "/" + key + "_" + section + ".txt";
+					rawBytes += _gfs::exists(path) ? (size_t)_gfs::file_size(path, error) : 0;
+				}
+
+				imported++;
+			}
+		}
+
+		history.repack();
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		size_t storedBytes = history.storedBytes();
+
+		std::cout << "Imported " << imported << " saves, " << rawBytes / 1e6 << " MB of text in " << seconds << " s" << std::endl;
+		std::cout << "Store: " << storedBytes / 1e6 << " MB in " << history.chunks.size() << " chunks, " << (double)rawBytes / storedBytes << ":1" << std::endl;
+
+		return mismatches ? 1 : 0;
+	}
+
+	// viscom --rename <key> <name>
+	int RenameDesign(std::string key, std::string name)
+	{
+		loadCatalog();
+		std::replace(name.begin(), name.end(), '\n', ' ');
+
+		for (auto& entry : catalog)
+		{
+			if (entry.key == key)
+			{
+				CatalogEntry renamed = entry;
+				renamed.name = name;
+				addToCatalog(renamed);
+				return 0;
+			}
+		}
+
+		std::cout << key << " is not in the catalog" << std::endl;
+		return 1;
+	}
+
+private:
+	olc::panzoom pz;
+	bool clockState = false;
+	int clockSpeed = 0;
+	int clockTicks = 0;
+	int targetFps = 60;  // Redraws are capped at this, the clock isn't
+	std::chrono::steady_clock::time_point lastRedraw;
+	std::chrono::steady_clock::time_point rateWindowStart;
+	int rateWindowFrames = 0;
+	long long rateWindowCycles = 0;
+	double measuredFps = 0;
+	double measuredHz = 0;
+	bool risingEdge = false;
+	bool fallingEdge = false;
+	long long clockCycles = 0;
+	InstructionEmulator emulator;
+	bool lockstepMode = false;
+	long long fastForwardCycles = 1000;
+	std::string emulatorStatus;
+	Netlist netlist;
+	CompiledNetlist compiledNetlist;
+	std::map<std::string, std::shared_ptr<const ModuleDefinition>> moduleDefinitions;  // The module library, see loadModuleLibrary
+	DirectoryWatcher moduleWatcher;
+	SpatialGrid spatialGrid;
+	std::vector<int> visibleComponents;  // Indices of what the last redraw found on screen
+	std::vector<int> visibleTerminals;
+	WireGeometry wires;  // Follows connections, see indexAppended
+	static constexpr float lodTerminalScale = 0.2f;  // Zoomed out past these terminals are left out,
+	static constexpr float lodTileScale = 0.05f;     // and then the canvas is drawn as tiles
+	static constexpr int lodTilePixels = 4;
+	std::map<int, LodLevel> lodLevels;  // By zoom bucket, built on first use
+	int visibleLodBucket = 0;
+	std::vector<int> visibleTiles;
+	std::vector<std::vector<int>> indicatorTerminals;  // By component, see findIndicatorTerminals
+	bool indicatorsValid = false;
+	std::unique_ptr<olc::Sprite> displayGlyphs[10];  // A digit of the display at displayGlyphScale
+	float displayGlyphScale = 0;
+	bool tiledRendering = false;  // T, draws the canvas in screen tiles on all cores
+	static constexpr int screenTileSize = 128;
+	int screenTileColumns = 0;
+	std::vector<ScreenTile> screenTiles;
+	WorkerPool renderPool;
+	static inline thread_local olc::vi2d drawClipLow = { INT_MIN, INT_MIN };  // Where the calling thread may
+	static inline thread_local olc::vi2d drawClipHigh = { INT_MAX, INT_MAX }; // draw, see Draw
+	std::unique_ptr<olc::Sprite> staticLayer;  // Everything that doesn't change with state, see DrawStaticLayer
+	bool staticLayerValid = false;
+	olc::vf2d staticLayerOffset;
+	olc::vf2d staticLayerScale;
+	std::string currentDesign = "1634261839";  // What L reloads, the last design saved or opened
+	std::string startupDesign;
+	std::vector<CatalogEntry> catalog;
+	bool catalogLoaded = false;
+	bool catalogOpen = false;
+	std::string catalogSearch;
+	int catalogSelection = 0;
+	std::string journalDesign;   // The design edits are journaled against, none until one is saved or opened
+	int journalGeneration = 0;
+	int journalEdits = 0;
+	std::ofstream journalFile;
+	std::thread saveThread;
+	std::atomic<bool> saving { false };
+	std::string savingDesign;
+	std::thread loadThread;
+	std::atomic<bool> loading { false };
+	std::string loadingDesign;
+	std::unique_ptr<Design> loader;     // The scratch design a background load parses into
+	int loaderGeneration = 0;           // and the journal generation it ends on
+	ChunkStore history;
+	std::map<int, std::vector<uint8_t>> moduleStates;  // Node values of each module instance by component id
+	std::map<int, int> moduleBaseIds;                  // and the id its pin ids are offset by
+	int selectedTerminalA = 0;
+	int selectedTerminalB = 0;
+	olc::vi2d selectedTerminalAPos;
+	olc::vi2d selectedTerminalBPos;
+	int activeInventoryComponent = 0;
+	std::vector<std::string> inventoryComponents = {
+		"DISPLAY",
+		"BUFFER",
+		"LED",
+		"FLAGSREG",
+		"TRANSISTOR",
+		"GATED LATCH",
+		"DECODER",
+		"MICROCOUNTER",
+		"IR",
+		"BUSTERM",
+		"ALU",
+		"COUNTER",
+		"RAM",
+	};
+	int activeWidthOption = 0;
+	std::map<std::string, std::vector<int>> componentWidthOptions = {
+		{ "ALU", { 8, 16, 32 } },     // Data bits
+		{ "COUNTER", { 4, 8, 16 } },  // Program counter bits
+		{ "RAM", { 4, 8, 16 } },      // Address bits, 16 B / 256 B / 64 KiB
+	};
+	int activeInventoryModule = 0;
+	bool placingModule = false;
+	std::vector<std::string> inventoryModules = {
+		"AND",
+		"OR",
+		"NAND",
+		"XOR",
+		"ADDER",
+		"REG",
+		"BITS",
+		"REGBUS",
+		"REGS",
+	};
+	bool simulationPaused = false;
+	bool updateSimulation = false;
+	bool componentBuilderMode = false;
+	bool redrawRequired = true;
+	bool ramFixMode = true;
+	bool showInfo = false;
+	Profiler profiler;  // G shows the panel, shift+G writes its history
+	bool showActivity = false;  // H, colours wires and components by how often they switched
+	std::vector<uint32_t> terminalToggles;  // Since activityStartCycles, see countToggles
+	long long activityStartCycles = 0;
+	std::vector<uint32_t> connectionToggles;  // Worked out from terminalToggles, see refreshActivity
+	std::vector<uint32_t> componentToggles;
+	uint32_t mostConnectionToggles = 0;
+	uint32_t mostComponentToggles = 0;
+	bool startZooming = false;
+	long long aluA = 0;
+	long long aluB = 0;
+	long long aluO = 0;
+	int selectedRamAddress = 0;
+	RamStore ramContents = loadProgram("fibonacci");
+	int currentBusColumn = 1;
+	std::vector<int> IRContents = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	std::vector<int> displayContents = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	std::vector<int> decoderContents = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+	std::vector<int> flagsRegContents = { 0, 0 };
+	int counterValue = 0;
+	int microcounterValue = 0;
+	bool counterCounted = false;
+	bool microcounterCounted = false;
+
+	void runSimulation()
+	{
+		Profiler::Timer timer(profiler, Profiler::SETTLE);
+		int waves = 0;
+		int transistorsEvaluated = 0;
+		int connectionsUpdated = 0;
+
+		std::vector<int> newVisitedTerminalIds;
+		std::vector<int> newVisitedTerminalIdsTwo;
+
+		std::vector<int> previousTerminalsState = {};
+		for (auto terminal : terminals)
+		{
+			previousTerminalsState.push_back(terminal.state);
+		}
+
+		if (updateSimulation && !simulationPaused)
+		{
+			redrawRequired = true;
+
+			for (auto& connection : connections)
+				connection.state = false;
+
+			for (auto& terminal : terminals)
+				if (terminal.type != "sourceStart" && terminal.type != "gatedOut" && !isBehaviouralOutput(terminal.type))
+				{
+					terminal.state = false;
+				}
+				else if (terminal.type == "clock")
+					terminal.state = clockState;
+
+			counterCounted = false;
+			microcounterCounted = false;
+
+			std::vector<int> transistorsToSimulate;
+			std::vector<int> gatedLatchesToSimulate;
+			std::vector<Terminal*> activeTerminals;
+			std::vector<Connection*> activeConnections;
+
+			updateSourceConnections();
+
+			for (auto currentConnection : sourceConnections)
+			{
+				if (currentConnection->terminalA == 1)
+					currentConnection->state = true;
+
+				if (currentConnection->terminalA == 3)
+					currentConnection->state = clockState;
+
+				Terminal* currentTerminalA = findTerminal(currentConnection->terminalA);
+				Terminal* currentTerminalB = findTerminal(currentConnection->terminalB);
+
+				newVisitedTerminalIds.push_back(currentConnection->terminalA);
+
+				if (isBehaviouralOutput(currentTerminalA->type))
+					currentConnection->state = currentTerminalA->state;
+
+				if (currentTerminalA->type == "gatedOut")
+					gatedLatchesToSimulate.push_back(currentTerminalA->componentId);
+
+				if (currentTerminalB)
+				{
+					newVisitedTerminalIds.push_back(currentConnection->terminalB);
+					currentTerminalB->state = currentConnection->state;
+
+					if (currentTerminalB->type == "buffer" || currentTerminalB->type == "moduleIn")
+						activeTerminals.push_back(currentTerminalB);
+					else if (currentTerminalB->type == "transCollector" || currentTerminalB->type == "transEmitter" || currentTerminalB->type == "transBase")
+						transistorsToSimulate.push_back(currentTerminalB->componentId);
+					else if (currentTerminalB->type == "gatedIn" || currentTerminalB->type == "gatedWriteEnable" || currentTerminalB->type == "gatedOut")
+						gatedLatchesToSimulate.push_back(currentTerminalB->componentId);
+
+				}
+			}
+
+			while ((transistorsToSimulate.size() || gatedLatchesToSimulate.size() || activeTerminals.size()))
+			{
+				waves++;
+				transistorsEvaluated += (int)transistorsToSimulate.size();
+
+				for (auto transistorId : transistorsToSimulate)
+				{
+					Terminal* thisNotOut = findTerminalByComponent(transistorId, "transNotOut");
+					Terminal* thisEmitter = findTerminalByComponent(transistorId, "transEmitter");
+
+					if (thisNotOut)
+					{
+						thisNotOut->state = false;
+						activeTerminals.push_back(thisNotOut);
+					}
+
+					if (thisEmitter)
+					{
+						thisEmitter->state = false;
+						activeTerminals.push_back(thisEmitter);
+					}
+
+					Terminal* thisNextTerminal = simulateTransistor(transistorId);
+
+					if (thisNextTerminal)
+					{
+						thisNextTerminal->state = true;
+						activeTerminals.push_back(thisNextTerminal);
+					}
+				}
+
+				transistorsToSimulate.clear();
+
+				for (auto gatedLatchId : gatedLatchesToSimulate)
+				{
+					Terminal* thisDataOut = findTerminalByComponent(gatedLatchId, "gatedOut");
+
+					bool originalDataOutState = false;
+					if (thisDataOut->state)
+						originalDataOutState = true;
+
+					simulateGatedLatch(gatedLatchId);
+					activeTerminals.push_back(thisDataOut);
+				}
+
+				gatedLatchesToSimulate.clear();				
+
+				for (auto terminal : activeTerminals)
+				{
+					for (auto& connection : connections)
+					{
+						if (connection.terminalA == terminal->id)
+						{
+							connection.state = terminal->state;
+							activeConnections.push_back(&connection);
+						}
+					}
+				}
+
+				activeTerminals.clear();
+				connectionsUpdated += (int)activeConnections.size();
+
+				for (auto connection : activeConnections)
+				{
+					Terminal* currentTerminalB = findTerminal(connection->terminalB);
+
+					if (std::find(newVisitedTerminalIds.begin(), newVisitedTerminalIds.end(), connection->terminalB) != newVisitedTerminalIds.end() && 1 == 2)					
+						newVisitedTerminalIds.erase(std::remove(newVisitedTerminalIds.begin(), newVisitedTerminalIds.end(), connection->terminalB), newVisitedTerminalIds.end());
+					else
+					{
+						newVisitedTerminalIds.push_back(connection->terminalB);
+
+						if (currentTerminalB)
+						{
+							int oldTerminalBState = currentTerminalB->state;
+							currentTerminalB->state = connection->state;
+							int newTerminalBState = currentTerminalB->state;
+
+
+							if (oldTerminalBState != newTerminalBState)
+							{
+								if (currentTerminalB->type == "buffer" || currentTerminalB->type == "moduleIn")
+									activeTerminals.push_back(currentTerminalB);
+								else if (currentTerminalB->type == "transBase" || currentTerminalB->type == "transCollector" || currentTerminalB->type == "transEmitter")
+									transistorsToSimulate.push_back(currentTerminalB->componentId);
+								else if (currentTerminalB->type == "gatedIn" || currentTerminalB->type == "gatedWriteEnable" || currentTerminalB->type == "gatedOut")
+									gatedLatchesToSimulate.push_back(currentTerminalB->componentId);
+								else if ("bus1" <= currentTerminalB->type && currentTerminalB->type <= "bus8")
+								{
+									for (auto& terminal : terminals)
+									{
+										if (terminal.type == currentTerminalB->type)
+										{
+											int oldState = terminal.state;
+											terminal.state = currentTerminalB->state;
+											activeTerminals.push_back(&terminal);
+											int newState = terminal.state;
+
+											if (oldState != newState)
+											{
+
+											}
+										}
+									}
+								}
+							}	
+						}
+					}
+				}
+
+				activeConnections.clear();
+
+				for (auto connection : connections)
+				{
+					if (connection.state)
+					{
+						for (auto& terminal : terminals)
+						{
+							if (terminal.id == connection.terminalB)
+							{
+								terminal.state = true;
+							}
+						}
+					}
+				}
+
+				// Simulate dynamic components
+				{
+					Profiler::Timer timer(profiler, Profiler::BEHAVIOURAL);
+					simulateALU();
+					simulateCounter();
+					simulateMicrocounter();
+					simulateIR();
+					simulateDecoder();
+					simulateFlagsReg();
+					simulateDisplay();
+					simulateRAM();
+					simulateModules();
+				}
+
+				updateSourceConnections();
+			}
+
+			profiler.sample(Profiler::WAVES, waves);
+			profiler.sample(Profiler::TRANSISTORS, transistorsEvaluated);
+			profiler.sample(Profiler::CONNECTIONS, connectionsUpdated);
+			countToggles(previousTerminalsState);
+
+			std::vector<int> newTerminalsState = {};
+			for (auto terminal : terminals)
+			{
+				newTerminalsState.push_back(terminal.state);
+			}
+
+			bool somethingChanged = false;
+			for (int i = 0; i < newTerminalsState.size(); i++)
+			{
+				if (previousTerminalsState[i] != newTerminalsState[i])
+				{
+					somethingChanged = true;
+					break;
+				}
+			}
+
+			if (!somethingChanged)
+				updateSimulation = false;
+		}
+	}
+
+	// Writes the design as one container under a fresh name in the background and journals further edits against it.
+	void Save()
+	{
+		// An earlier save still being written would not show up as taken below.
+		finishSave();
+
+		std::string timestamp = std::to_string(std::time(0));
+		std::string name = timestamp;
+
+		// Two saves within the same second get numbered instead of overwriting each other.
+		for (int copy = 2; std::ifstream("saves/" + name + ".vsave").good(); copy++)
+			name = timestamp + "-" + std::to_string(copy);
+
+		SaveManifest manifest;
+		manifest.name = name;
+
+		addToCatalog(catalogEntry("save", name, name, components, terminals.size(), connections.size()));
+		currentDesign = name;
+		startJournal(name, 0);
+		saveInBackground(name, manifest, 0, "saves/" + name);
+	}
+
+	bool SaveContainer(std::string path, std::string name)
+	{
+		SaveManifest manifest;
+		manifest.name = name;
+		manifest.components = (int)components.size();
+		manifest.terminals = (int)terminals.size();
+		manifest.connections = (int)connections.size();
+
+		return writeContainer(path, manifest, encodeBinary());
+	}
+
+	// Static so a compaction can run it on a copy of the design from another thread. Goes through a temporary
+	// file so a crash mid-save never leaves a partial save behind.
+	static bool writeContainer(std::string path, SaveManifest manifest, const std::string& body)
+	{
+		manifest.created = (long long)std::time(0);
+		manifest.hash = contentHash(body.data(), body.size());
+		manifest.bodySize = body.size();
+
+		std::string temporaryPath = path + ".tmp";
+		std::ofstream file(temporaryPath, std::ios::binary);
+		file << manifest.text();
+		file.write(body.data(), body.size());
+		file.close();
+
+		// Unlike std::rename this replaces an existing container on Windows too.
+		std::error_code error;
+		if (file)
+			_gfs::rename(temporaryPath, path, error);
+
+		if (!file || error)
+		{
+			std::remove(temporaryPath.c_str());
+			std::cout << "Could not write " << path << std::endl;
+			return false;
+		}
 
-					// Display Write Enable
-					terminals.push_back({ lastTerminalId, worldMouse + olc::vf2d(width, height / 2), false, "displayWriteEnable", lastComponentId });
-					lastTerminalId++;
-				}
+		return true;
+	}
 
-				if (inventoryComponents[activeInventoryComponent] == "BUFFER")
-				{
-					terminals.push_back({ lastTerminalId, GetWorldMouse(), false, "buffer", lastComponentId });
-					lastTerminalId++;
-				}
+	bool readManifest(std::string path, SaveManifest& manifest)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return file.is_open() && manifest.parse(file);
+	}
 
-				if (inventoryComponents[activeInventoryComponent] == "BUSTERM")
-				{
-					std::string termType = "";
-					if (currentBusColumn == 1)
-						termType = "bus1";
-					else if (currentBusColumn == 2)
-						termType = "bus2";
-					else if (currentBusColumn == 3)
-						termType = "bus3";
-					else if (currentBusColumn == 4)
-						termType = "bus4";
-					else if (currentBusColumn == 5)
-						termType = "bus5";
-					else if (currentBusColumn == 6)
-						termType = "bus6";
-					else if (currentBusColumn == 7)
-						termType = "bus7";
-					else if (currentBusColumn == 8)
-						termType = "bus8";
-					
-					terminals.push_back({ lastTerminalId, GetWorldMouse(), false, termType, lastComponentId });
-					lastTerminalId++;
-				}
+	std::string encodeBinary()
+	{
+		return encodeBinary(components, terminals, connections, lastTerminalId, lastConnectionId, lastComponentId);
+	}
+
+	static std::string encodeBinary(const std::vector<Component>& components, const std::vector<Terminal>& terminals, const std::vector<Connection>& connections, int lastTerminalId, int lastConnectionId, int lastComponentId)
+	{
+		std::vector<std::string> strings;
+		std::map<std::string, uint32_t> stringIndices;
+
+		auto intern = [&](const std::string& text)
+		{
+			auto found = stringIndices.find(text);
+			if (found != stringIndices.end())
+				return found->second;
+
+			stringIndices[text] = (uint32_t)strings.size();
+			strings.push_back(text);
+			return (uint32_t)strings.size() - 1;
+		};
+
+		std::vector<BinarySave::ComponentRecord> componentRecords;
+		for (auto& component : components)
+			componentRecords.push_back({ component.id, intern(component.type), component.pos.x, component.pos.y, component.width });
+
+		std::vector<BinarySave::TerminalRecord> terminalRecords;
+		std::map<int, int> terminalIndices;
+		for (auto& terminal : terminals)
+		{
+			// Saves can repeat a terminal id, findTerminal resolves it to the first one.
+			if (!terminalIndices.count(terminal.id))
+				terminalIndices[terminal.id] = (int)terminalRecords.size();
+
+			terminalRecords.push_back({ terminal.id, terminal.pos.x, terminal.pos.y, intern(terminal.type), terminal.componentId });
+		}
+
+		std::vector<BinarySave::ConnectionRecord> connectionRecords;
+		std::vector<uint32_t> adjacencyOffsets(terminals.size() + 1, 0);
+		for (auto& connection : connections)
+		{
+			connectionRecords.push_back({ connection.id, connection.terminalA, connection.terminalB, connection.terminalAPos.x, connection.terminalAPos.y, connection.terminalBPos.x, connection.terminalBPos.y, connection.notOutTerminal });
+
+			if (terminalIndices.count(connection.terminalA))
+				adjacencyOffsets[terminalIndices[connection.terminalA] + 1]++;
+		}
+
+		for (size_t i = 1; i < adjacencyOffsets.size(); i++)
+			adjacencyOffsets[i] += adjacencyOffsets[i - 1];
+
+		std::vector<uint32_t> adjacency(adjacencyOffsets.back());
+		std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (int i = 0; i < (int)connections.size(); i++)
+			if (terminalIndices.count(connections[i].terminalA))
+				adjacency[adjacencyFill[terminalIndices[connections[i].terminalA]]++] = i;
+
+		std::vector<uint32_t> stringOffsets;
+		std::string stringBytes;
+		for (auto& text : strings)
+		{
+			stringOffsets.push_back((uint32_t)stringBytes.size());
+			stringBytes += text;
+		}
+
+		stringOffsets.push_back((uint32_t)stringBytes.size());
+		stringBytes.resize((stringBytes.size() + 3) & ~size_t(3), '\0');
+
+		BinarySave::Header header = {
+			BinarySave::magic,
+			BinarySave::version,
+			lastTerminalId,
+			lastConnectionId,
+			lastComponentId,
+			(uint32_t)componentRecords.size(),
+			(uint32_t)terminalRecords.size(),
+			(uint32_t)connectionRecords.size(),
+			(uint32_t)strings.size(),
+			(uint32_t)stringBytes.size(),
+			(uint32_t)adjacency.size(),
+		};
+
+		std::string body;
+		body.append((const char*)&header, sizeof(header));
+		body.append((const char*)componentRecords.data(), componentRecords.size() * sizeof(BinarySave::ComponentRecord));
+		body.append((const char*)terminalRecords.data(), terminalRecords.size() * sizeof(BinarySave::TerminalRecord));
+		body.append((const char*)connectionRecords.data(), connectionRecords.size() * sizeof(BinarySave::ConnectionRecord));
+		body.append((const char*)stringOffsets.data(), stringOffsets.size() * sizeof(uint32_t));
+		body.append(stringBytes);
+		body.append((const char*)adjacencyOffsets.data(), adjacencyOffsets.size() * sizeof(uint32_t));
+		body.append((const char*)adjacency.data(), adjacency.size() * sizeof(uint32_t));
+		return body;
+	}
+
+	// Parses every module in the inventory up front, placing one then never touches the disk.
+	void loadModuleLibrary()
+	{
+		for (auto& module_name : inventoryModules)
+			moduleDefinition(module_name);
+
+		moduleWatcher.open("modules");
+	}
+
+	_gfs::file_time_type moduleModified(std::string module_name)
+	{
+		_gfs::file_time_type newest = _gfs::file_time_type::min();
+
+		for (std::string file : { "components.txt", "connections.txt", "terminals.txt" })
+		{
+			std::error_code error;
+			_gfs::file_time_type modified = _gfs::last_write_time("modules/" + module_name + "_" + file, error);
+
+			if (!error)
+				newest = std::max(newest, modified);
+		}
+
+		return newest;
+	}
+
+	// Parses again any module whose files were written since it was read. The pin terminals of placed instances
+	// were made from the old definition, so a placed module whose pins changed keeps the old one.
+	void reloadChangedModules()
+	{
+		if (!moduleWatcher.changed())
+			return;
+
+		std::vector<std::string> changedModules;
+		for (auto& module : moduleDefinitions)
+			if (moduleModified(module.first) != module.second->modified)
+				changedModules.push_back(module.first);
+
+		for (auto& module_name : changedModules)
+		{
+			std::shared_ptr<const ModuleDefinition> previous = moduleDefinitions[module_name];
+			moduleDefinitions.erase(module_name);
+			const ModuleDefinition* reloaded = moduleDefinition(module_name);
+
+			if (!samePins(*previous, *reloaded) && modulePlaced(module_name))
+			{
+				moduleDefinitions[module_name] = previous;
+				std::cout << "Not reloading module " << module_name << ", its pins changed and it is placed in the design" << std::endl;
+				continue;
+			}
+
+			// The old node values are indexed by the old netlist.
+			for (auto& component : components)
+				if (isModuleInstance(component) && component.type.substr(7) == module_name)
+					moduleStates[component.id].assign(reloaded->netlist.nodes.size(), 0);
+
+			std::cout << "Reloaded module " << module_name << std::endl;
+		}
+
+		if (changedModules.size())
+		{
+			spatialGrid.valid = false;
+			updateSimulation = true;
+			redrawRequired = true;
+		}
+	}
+
+	// Every pin keeps its id, position and direction.
+	static bool samePins(const ModuleDefinition& a, const ModuleDefinition& b)
+	{
+		if (a.pins.size() != b.pins.size() || a.firstPinId != b.firstPinId)
+			return false;
+
+		for (size_t i = 0; i < a.pins.size(); i++)
+		{
+			const Terminal& pinA = a.terminals[a.pins[i]];
+			const Terminal& pinB = b.terminals[b.pins[i]];
+			bool inputA = a.netlist.nodes[a.netlist.terminalNodes[a.pins[i]]].kind == Netlist::NODE_EXTERNAL;
+			bool inputB = b.netlist.nodes[b.netlist.terminalNodes[b.pins[i]]].kind == Netlist::NODE_EXTERNAL;
+
+			if (pinA.id != pinB.id || pinA.pos != pinB.pos || inputA != inputB)
+				return false;
+		}
+
+		return true;
+	}
+
+	bool modulePlaced(std::string module_name)
+	{
+		for (auto& component : components)
+			if (isModuleInstance(component) && component.type.substr(7) == module_name)
+				return true;
+
+		return false;
+	}
+
+	// Parses a module the first time it is asked for. Pins are the terminals left open inside the module: inputs
+	// nothing inside drives and outputs that drive nothing inside.
+	const ModuleDefinition* moduleDefinition(std::string module_name)
+	{
+		auto cached = moduleDefinitions.find(module_name);
+		if (cached != moduleDefinitions.end())
+			return cached->second.get();
+
+		std::shared_ptr<ModuleDefinition> definition = std::make_shared<ModuleDefinition>();
+		definition->name = module_name;
+		moduleDefinitions[module_name] = definition;
+
+		std::string filepath = "modules/" + module_name + "_";
+		MappedFile componentsFile, connectionsFile, terminalsFile;
+		componentsFile.open(filepath + "components.txt");
+		connectionsFile.open(filepath + "connections.txt");
+		terminalsFile.open(filepath + "terminals.txt");
+
+		CsvReader componentsReader((const char*)componentsFile.data, componentsFile.size, filepath + "components.txt");
+		CsvReader connectionsReader((const char*)connectionsFile.data, connectionsFile.size, filepath + "connections.txt");
+		CsvReader terminalsReader((const char*)terminalsFile.data, terminalsFile.size, filepath + "terminals.txt");
+
+		readComponents(componentsReader, definition->components);
+		readConnections(connectionsReader, definition->connections);
+		readTerminals(terminalsReader, definition->terminals);
+
+		if (definition->components.size())
+			definition->lastComponentId = definition->components.back().id;
+		if (definition->connections.size())
+			definition->lastConnectionId = definition->connections.back().id;
+		if (definition->terminals.size())
+			definition->lastTerminalId = definition->terminals.back().id;
+
+		definition->modified = moduleModified(module_name);
+
+		// The placement ghost outlines the bounds, the margin covers the component drawings around each position.
+		if (definition->terminals.size())
+			definition->boundsMin = definition->boundsMax = definition->terminals[0].pos;
+
+		for (auto& component : definition->components)
+		{
+			definition->boundsMin = definition->boundsMin.min(component.pos - olc::vi2d(25, 25));
+			definition->boundsMax = definition->boundsMax.max(component.pos + olc::vi2d(25, 25));
+		}
+
+		for (auto& terminal : definition->terminals)
+		{
+			definition->boundsMin = definition->boundsMin.min(terminal.pos - olc::vi2d(10, 10));
+			definition->boundsMax = definition->boundsMax.max(terminal.pos + olc::vi2d(10, 10));
+		}
+
+		for (int i = 0; i < (int)definition->terminals.size(); i++)
+			if (!definition->terminalIndices.count(definition->terminals[i].id))
+				definition->terminalIndices[definition->terminals[i].id] = i;
+
+		definition->indicatorTerminals = findIndicatorTerminals(definition->components, definition->terminals);
+
+		std::map<int, bool> driven;
+		std::map<int, bool> drives;
+		for (auto& connection : definition->connections)
+		{
+			driven[connection.terminalB] = true;
+			drives[connection.terminalA] = true;
+		}
+
+		definition->netlist = buildNetlist(definition->terminals, definition->connections, definition->components, false);
+
+		for (int i = 0; i < (int)definition->terminals.size(); i++)
+		{
+			Terminal& terminal = definition->terminals[i];
+			bool input = !driven[terminal.id] && (terminal.type == "buffer" || terminal.type == "transBase" || terminal.type == "transCollector" || terminal.type == "gatedIn" || terminal.type == "gatedWriteEnable");
+			bool output = !drives[terminal.id] && (terminal.type == "buffer" || terminal.type == "transEmitter" || terminal.type == "transNotOut" || terminal.type == "gatedOut");
+
+			if (!input && !output)
+				continue;
+
+			// Inputs are written by the instance before every evaluation.
+			if (input)
+			{
+				Netlist::Node& node = definition->netlist.nodes[definition->netlist.terminalNodes[i]];
+				node.kind = Netlist::NODE_EXTERNAL;
+				node.fanIn.clear();
+			}
+
+			if (definition->pins.empty() || terminal.id < definition->firstPinId)
+				definition->firstPinId = terminal.id;
+
+			definition->pins.push_back(i);
+		}
+
+		definition->netlist.prepare();
+		return definition.get();
+	}
+
+	bool isModuleInstance(const Component& component)
+	{
+		return component.type.compare(0, 7, "MODULE ") == 0;
+	}
+
+	// Places one component referencing the shared definition plus its pins. Pin ids keep their offset from the
+	// module file, so the first pin id of an instance is enough to find the rest.
+	void PlaceModule(std::string module_name)
+	{
+		const ModuleDefinition* definition = moduleDefinition(module_name);
+
+		if (definition->pins.empty())
+			return;
+
+		components.push_back({ lastComponentId, "MODULE " + module_name, GetWorldMouse() });
+
+		for (int pin : definition->pins)
+		{
+			const Terminal& terminal = definition->terminals[pin];
+			bool input = definition->netlist.nodes[definition->netlist.terminalNodes[pin]].kind == Netlist::NODE_EXTERNAL;
+
+			terminals.push_back({ terminal.id + lastTerminalId, terminal.pos + GetWorldMouse(), false, input ? "moduleIn" : "moduleOut", lastComponentId });
+		}
+
+		moduleStates[lastComponentId].assign(definition->netlist.nodes.size(), 0);
+		moduleBaseIds[lastComponentId] = lastTerminalId;
+
+		lastComponentId++;
+		lastTerminalId += definition->lastTerminalId + 1;
+		updateSourceConnections();
+		updateSimulation = true;
+	}
+
+	// Copies every component, connection and terminal of the module into the design so it can be edited. Each list
+	// is copied in one go from the library and then offset in place.
+	void PlaceFlattenedModule(std::string module_name)
+	{
+		const ModuleDefinition* definition = moduleDefinition(module_name);
+		olc::vi2d worldMouse = GetWorldMouse();
+
+		size_t firstComponent = components.size();
+		components.insert(components.end(), definition->components.begin(), definition->components.end());
+		for (size_t i = firstComponent; i < components.size(); i++)
+		{
+			components[i].id += lastComponentId;
+			components[i].pos += worldMouse;
+		}
+
+		size_t firstConnection = connections.size();
+		connections.insert(connections.end(), definition->connections.begin(), definition->connections.end());
+		for (size_t i = firstConnection; i < connections.size(); i++)
+		{
+			connections[i].id += lastConnectionId;
+			connections[i].terminalA += lastTerminalId;
+			connections[i].terminalB += lastTerminalId;
+			connections[i].terminalAPos += worldMouse;
+			connections[i].terminalBPos += worldMouse;
+			connections[i].notOutTerminal += lastTerminalId;
+		}
+
+		size_t firstTerminal = terminals.size();
+		terminals.insert(terminals.end(), definition->terminals.begin(), definition->terminals.end());
+		for (size_t i = firstTerminal; i < terminals.size(); i++)
+		{
+			terminals[i].id += lastTerminalId;
+			terminals[i].pos += worldMouse;
+			terminals[i].state = false;
+			terminals[i].componentId += lastComponentId;
+		}
+
+		lastComponentId += definition->lastComponentId + 1;
+		lastConnectionId += definition->lastConnectionId + 1;
+		lastTerminalId += definition->lastTerminalId + 1;
+		updateSourceConnections();
+		updateSimulation = true;
+	}
+
+	// Evaluates every module instance against its shared definition, like the other behavioural components.
+	void simulateModules()
+	{
+		std::map<int, std::vector<Terminal*>> instancePins;
+		for (auto& terminal : terminals)
+			if (terminal.type == "moduleIn" || terminal.type == "moduleOut")
+				instancePins[terminal.componentId].push_back(&terminal);
+
+		if (instancePins.empty())
+			return;
+
+		for (auto& component : components)
+		{
+			auto pins = instancePins.find(component.id);
+			if (pins == instancePins.end() || !isModuleInstance(component))
+				continue;
+
+			const ModuleDefinition* definition = moduleDefinition(component.type.substr(7));
+			const Netlist& moduleNetlist = definition->netlist;
+			std::vector<uint8_t>& values = moduleStates[component.id];
+
+			if (values.size() != moduleNetlist.nodes.size())
+				values.assign(moduleNetlist.nodes.size(), 0);
+
+			// Saves don't record the offset, so a loaded instance takes it from its pins the first time it runs,
+			// before any of them can be deleted.
+			auto base = moduleBaseIds.find(component.id);
+			if (base == moduleBaseIds.end())
+			{
+				int firstPinId = pins->second.front()->id;
+				for (auto pin : pins->second)
+					firstPinId = std::min(firstPinId, pin->id);
+
+				base = moduleBaseIds.emplace(component.id, firstPinId - definition->firstPinId).first;
+			}
+
+			int idOffset = base->second;
+
+			for (auto pin : pins->second)
+			{
+				auto index = definition->terminalIndices.find(pin->id - idOffset);
+				if (pin->type == "moduleIn" && index != definition->terminalIndices.end())
+					values[moduleNetlist.terminalNodes[index->second]] = pin->state;
+			}
+
+			moduleNetlist.evaluate(values, risingEdge);
+
+			for (auto pin : pins->second)
+			{
+				auto index = definition->terminalIndices.find(pin->id - idOffset);
+				if (pin->type == "moduleOut" && index != definition->terminalIndices.end())
+					pin->state = values[moduleNetlist.terminalNodes[index->second]];
+			}
+		}
+	}
+
+	// Loads the current design when no save is named, see currentDesign.
+	void Load(std::string load_timestamp = "")
+	{
+		if (load_timestamp.empty())
+			load_timestamp = currentDesign;
+
+		// A save still writing this design's snapshot could otherwise delete journals out from under us.
+		finishSave();
+
+		int generation = readDesign(load_timestamp, history);
+		designLoaded(load_timestamp, generation);
+	}
+
+	// Parses the design into a scratch Design on the load thread, the one on screen keeps running until
+	// finishLoad swaps it in at the start of a frame.
+	void LoadInBackground(std::string load_timestamp = "")
+	{
+		if (load_timestamp.empty())
+			load_timestamp = currentDesign;
+
+		if (loading)
+			return;
+
+		finishSave();
+
+		if (loadThread.joinable())
+			loadThread.join();
+
+		loader = std::make_unique<Design>();
+		loading = true;
+		loadingDesign = load_timestamp;
+		loadThread = std::thread([this, load_timestamp]()
+		{
+			loaderGeneration = loader->readDesign(load_timestamp, history);
+			loading = false;
+		});
+	}
+
+	void finishLoad()
+	{
+		if (!loader || loading)
+			return;
+
+		loadThread.join();
+
+		// Swapping keeps the elements where they are, so sourceConnections still points into connections.
+		components.swap(loader->components);
+		terminals.swap(loader->terminals);
+		connections.swap(loader->connections);
+		sourceConnections.swap(loader->sourceConnections);
+		lastTerminalId = loader->lastTerminalId;
+		lastConnectionId = loader->lastConnectionId;
+		lastComponentId = loader->lastComponentId;
+
+		int generation = loaderGeneration;
+		int loadedSnapshot = loader->snapshotGeneration;
+		loader.reset();
+
+		// Reloading the open design never goes back to a generation it has already moved past.
+		if (loadingDesign == journalDesign)
+		{
+			generation = std::max(generation, journalGeneration);
+			loadedSnapshot = std::max(loadedSnapshot, snapshotGeneration);
+		}
+
+		snapshotGeneration = loadedSnapshot;
+
+		designLoaded(loadingDesign, generation);
+		redrawRequired = true;
+	}
+
+	void designLoaded(std::string load_timestamp, int generation)
+	{
+		currentDesign = load_timestamp;
+		spatialGrid.valid = false;
+		startJournal(load_timestamp, generation);
+
+		moduleStates.clear();
+		moduleBaseIds.clear();
+		configureRAM(componentWidth("RAM", 4));
+		resetToggles();
+		updateSimulation = true;
+	}
+
+	// --- Journal ---------------------------------------------------------------------------
+	// Every edit to a saved design is appended to saves/<design>.<generation>.journal as it happens, one line per
+	// element added or removed:
+	//   C,id,x,y,width,type             component placed (modules are a component plus their pins)
+	//   T,id,x,y,componentId,type       terminal added
+	//   W,id,a,b,ax,ay,bx,by,notOut     connection added
+	//   -C,index  -T,index  -W,index    element removed, by position so repeated ids replay exactly
+	//   G,terminal,connection,component the next ids
+	// The container is the snapshot, its manifest says which generation to replay from. Compacting starts the next
+	// generation and writes a new snapshot in the background, older journals are deleted once it is in place.
+
+	void startJournal(std::string design, int generation)
+	{
+		journalFile.close();
+		journalDesign = design;
+		journalGeneration = generation;
+		journalEdits = 0;
+	}
+
+	void journalLine(const std::string& line)
+	{
+		if (journalDesign.empty())
+			return;
+
+		// Opened on the first edit so loading a design never creates an empty journal.
+		if (!journalFile.is_open())
+			journalFile.open(journalPath(journalDesign, journalGeneration), std::ios::app);
+
+		journalFile << line << "\n";
+	}
+
+	// Writes down whatever an edit appended after the given sizes.
+	void journalAppended(size_t componentCount, size_t terminalCount, size_t connectionCount)
+	{
+		if (components.size() <= componentCount && terminals.size() <= terminalCount && connections.size() <= connectionCount)
+			return;
+
+		for (size_t i = componentCount; i < components.size(); i++)
+		{
+			auto& component = components[i];
+			journalLine("C," + std::to_string(component.id) + "," + std::to_string(component.pos.x) + "," + std::to_string(component.pos.y) + "," + std::to_string(component.width) + "," + component.type);
+		}
+
+		for (size_t i = terminalCount; i < terminals.size(); i++)
+		{
+			auto& terminal = terminals[i];
+			journalLine("T," + std::to_string(terminal.id) + "," + std::to_string(terminal.pos.x) + "," + std::to_string(terminal.pos.y) + "," + std::to_string(terminal.componentId) + "," + terminal.type);
+		}
+
+		for (size_t i = connectionCount; i < connections.size(); i++)
+		{
+			auto& connection = connections[i];
+			journalLine("W," + std::to_string(connection.id) + "," + std::to_string(connection.terminalA) + "," + std::to_string(connection.terminalB) + "," + std::to_string(connection.terminalAPos.x) + "," + std::to_string(connection.terminalAPos.y) + "," + std::to_string(connection.terminalBPos.x) + "," + std::to_string(connection.terminalBPos.y) + "," + std::to_string(connection.notOutTerminal));
+		}
+
+		journalLine("G," + std::to_string(lastTerminalId) + "," + std::to_string(lastConnectionId) + "," + std::to_string(lastComponentId));
+		flushJournal();
+	}
+
+	void journalRemoved(std::string kind, size_t index)
+	{
+		journalLine("-" + kind + "," + std::to_string(index));
+	}
+
+	// One flush per edit, a crash loses at most the edit in progress.
+	void flushJournal()
+	{
+		if (!journalFile.is_open())
+			return;
+
+		journalFile.flush();
+		journalEdits++;
+
+		if (journalEdits >= 256)
+			compactJournal();
+	}
+
+	// Folds the journal into a new snapshot in the background. Edits from here on go to the next generation.
+	void compactJournal()
+	{
+		// A load may still be replaying the journals the new snapshot would let the save thread delete.
+		if (journalDesign.empty() || saving || loading)
+			return;
+
+		std::string design = journalDesign;
+		int generation = journalGeneration + 1;
+		int oldestGeneration = snapshotGeneration;
+		startJournal(design, generation);
+		snapshotGeneration = generation;
+
+		SaveManifest manifest;
+		if (!readManifest("saves/" + design + ".vsave", manifest))
+			manifest.name = design;
+
+		manifest.journal = generation;
+
+		loadCatalog();
+		auto existing = std::find_if(catalog.begin(), catalog.end(), [&](const CatalogEntry& entry) { return entry.kind == "save" && entry.key == design; });
+		addToCatalog(catalogEntry("save", design, existing != catalog.end() ? existing->name : manifest.name, components, terminals.size(), connections.size()));
+
+		// Every compaction is kept in the history, at the cost of the chunks it changed.
+		saveInBackground(design, manifest, oldestGeneration, "saves/" + design + "@" + std::to_string(std::time(0)));
+	}
+
+	// Writes the container and the history snapshot from a copy of the design on the save thread, so the
+	// simulation and editing carry on meanwhile. Journals older than the manifest's generation are deleted once
+	// the container that covers them is in place.
+	void saveInBackground(std::string design, SaveManifest manifest, int oldestGeneration, std::string historyKey)
+	{
+		finishSave();
 
-				if (inventoryComponents[activeInventoryComponent] == "LED")
-				{
-					terminals.push_back({ lastTerminalId, GetWorldMouse(), false, "buffer", lastComponentId });
-					lastTerminalId++;
-				}
+		manifest.components = (int)components.size();
+		manifest.terminals = (int)terminals.size();
+		manifest.connections = (int)connections.size();
 
-				lastComponentId++;
-			}
+		saving = true;
+		savingDesign = design;
+		saveThread = std::thread([this, design, manifest, oldestGeneration, historyKey, components = components, terminals = terminals, connections = connections, ids = std::vector<int>{ lastTerminalId, lastConnectionId, lastComponentId }]()
+		{
+			std::string body = encodeBinary(components, terminals, connections, ids[0], ids[1], ids[2]);
+
+			if (writeContainer("saves/" + design + ".vsave", manifest, body))
+				for (int old = oldestGeneration; old < manifest.journal; old++)
+					std::remove(journalPath(design, old).c_str());
+
+			history.put(historyKey, textDocument(components, terminals, connections, ids[0], ids[1], ids[2]), (long long)std::time(0));
+			saving = false;
+		});
+	}
+
+	void finishSave()
+	{
+		if (saveThread.joinable())
+			saveThread.join();
+	}
+
+	CatalogEntry catalogEntry(std::string kind, std::string key, std::string name, const std::vector<Component>& parts, size_t terminalCount, size_t connectionCount)
+	{
+		CatalogEntry entry;
+		entry.kind = kind;
+		entry.key = key;
+		entry.name = name;
+		entry.components = (int)parts.size();
+		entry.terminals = (int)terminalCount;
+		entry.connections = (int)connectionCount;
+		entry.created = (long long)std::time(0);
+		entry.thumbnail = CatalogEntry::makeThumbnail(parts);
+		return entry;
+	}
+
+	// Reads saves/catalog.txt, building it from a one off scan of saves/ and modules/ if there is none yet.
+	void loadCatalog()
+	{
+		if (catalogLoaded)
+			return;
+
+		catalogLoaded = true;
+		catalog.clear();
+
+		std::ifstream catalogFile("saves/catalog.txt");
+		if (!catalogFile.is_open())
+		{
+			rebuildCatalog();
+			return;
+		}
+
+		std::map<std::string, size_t> entryIndices;
+		std::string line;
+		int lines = 0;
+
+		while (std::getline(catalogFile, line))
+		{
+			CatalogEntry entry;
+			if (!entry.parse(line))
+				continue;
+
+			lines++;
+			std::string id = entry.kind + "," + entry.key;
+
+			if (entryIndices.count(id))
+				catalog[entryIndices[id]] = entry;
 			else
 			{
-				PlaceModule(inventoryModules[activeInventoryModule]);
+				entryIndices[id] = catalog.size();
+				catalog.push_back(entry);
 			}
+		}
 
+		// Renames and repeated saves only ever append, drop the lines they replaced once there are enough of them.
+		if (lines > (int)catalog.size() + 64)
+			writeCatalog();
+	}
 
-			redrawRequired = true;
-		}
+	void rebuildCatalog()
+	{
+		static const std::map<std::string, std::string> knownSaves = {
+			{ "1634261839", "Full Computer" },
+			{ "1634296642", "Full Demo" },
+			{ "1634172481", "ALU Testing" },
+			{ "1634283966", "RAM Testing" },
+		};
+
+		std::vector<std::string> saveKeys;
+		std::vector<std::string> moduleNames;
 
-		if (GetKey(olc::DEL).bReleased)
+		for (auto& entry : _gfs::directory_iterator("saves"))
 		{
-			deleteClosest();
-			redrawRequired = true;
+			std::string name = entry.path().filename().string();
+
+			if (name.size() > 14 && name.compare(name.size() - 14, 14, "_terminals.txt") == 0)
+				saveKeys.push_back(name.substr(0, name.size() - 14));
+			else if (name.size() > 6 && name.compare(name.size() - 6, 6, ".vsave") == 0)
+				saveKeys.push_back(name.substr(0, name.size() - 6));
 		}
 
+		for (auto& entry : _gfs::directory_iterator("modules"))
+		{
+			std::string name = entry.path().filename().string();
+
+			if (name.size() > 15 && name.compare(name.size() - 15, 15, "_components.txt") == 0)
+				moduleNames.push_back(name.substr(0, name.size() - 15));
+		}
 
-		if (GetKey(olc::S).bReleased)
-			Save();
+		// A text save that has been compacted has a container next to it.
+		std::sort(saveKeys.begin(), saveKeys.end());
+		saveKeys.erase(std::unique(saveKeys.begin(), saveKeys.end()), saveKeys.end());
+		std::sort(moduleNames.begin(), moduleNames.end());
 
-		if (GetKey(olc::L).bReleased)
+		for (auto& key : saveKeys)
 		{
-			Save();
-			Load();
-			redrawRequired = true;
+			// Read into a scratch design so the open one is left alone.
+			Design scanner;
+			scanner.readDesign(key, history);
+
+			auto knownName = knownSaves.find(key);
+			SaveManifest manifest;
+			std::string name = knownName != knownSaves.end() ? knownName->second : readManifest("saves/" + key + ".vsave", manifest) ? manifest.name : key;
+
+			CatalogEntry entry = catalogEntry("save", key, name, scanner.components, scanner.terminals.size(), scanner.connections.size());
+			entry.created = std::atoll(key.c_str());
+			catalog.push_back(entry);
 		}
 
-		if (GetMouse(1).bReleased)
+		for (auto& name : moduleNames)
 		{
-			bool needsNotOut = false;
-			int transistorId = 0;
+			const ModuleDefinition* definition = moduleDefinition(name);
+			catalog.push_back(catalogEntry("module", name, name, definition->components, definition->terminals.size(), definition->connections.size()));
+		}
 
-			if (!selectedTerminalA)
-			{
-				double smallestDistance = 0.00;
-				int closestTerminalId = 0;
-				olc::vi2d closestTerminalPos;
+		writeCatalog();
+	}
 
-				for (auto terminal : terminals)
-				{
-					double distance = CalculateDistance(terminal.pos, GetWorldMouse());
+	void writeCatalog()
+	{
+		std::string temporaryPath = "saves/catalog.txt.tmp";
+		std::ofstream catalogFile(temporaryPath);
 
-					if (distance < smallestDistance || smallestDistance == 0.00)
-					{
-						if (terminal.type == "sourceStart" || terminal.type == "transEmitter" || terminal.type == "transNotOut" || terminal.type == "buffer" || terminal.type == "gatedOut" || terminal.type == "clock" || ("aluOut1" <= terminal.type && terminal.type <= "aluOut8") || ("ramOut1" <= terminal.type && terminal.type <= "ramOut8") || ("bus1" <= terminal.type && terminal.type <= "bus8") || ("counterOut1" <= terminal.type && terminal.type <= "counterOut4") || ("microcounterOut1" <= terminal.type && terminal.type <= "microcounterOut3") || ("IROut1" <= terminal.type && terminal.type <= "IROut4") || ("IRDecodeOut5" <= terminal.type && terminal.type <= "IRDecodeOut8") || terminal.type.find("decoderOut") != std::string::npos || ("flagsRegOut1" <= terminal.type && terminal.type <= "flagsRegOut2") || (terminal.type == "aluZeroFlagOut" || terminal.type == "aluCarryFlagOut"))
-						{
-							smallestDistance = distance;
-							closestTerminalId = terminal.id;
-							closestTerminalPos = terminal.pos;
-						}
-					}
-				}
+		for (auto& entry : catalog)
+			catalogFile << entry.line() << std::endl;
 
-				if (smallestDistance < 10.00)
-				{
-					selectedTerminalA = closestTerminalId;
-					selectedTerminalAPos = closestTerminalPos;
-				}
-			}
-			else
-			{
-				double smallestDistance = 0.00;
-				int closestTerminalId = 0;
-				olc::vi2d closestTerminalPos;
+		catalogFile.close();
+		std::remove("saves/catalog.txt");
+		std::rename(temporaryPath.c_str(), "saves/catalog.txt");
+	}
 
-				for (auto terminal : terminals)
-				{
-					double distance = CalculateDistance(terminal.pos, GetWorldMouse());
+	void addToCatalog(const CatalogEntry& entry)
+	{
+		loadCatalog();
 
-					if (distance < smallestDistance || smallestDistance == 0.00)
-					{
-						if (terminal.type == "transCollector" || terminal.type == "transBase" || terminal.type == "sourceEnd" || terminal.type == "buffer" || terminal.type == "gatedIn" || terminal.type == "gatedWriteEnable" || ("aluInA1" <= terminal.type && terminal.type <= "aluInA8") || ("aluInB1" <= terminal.type && terminal.type <= "aluInB8") || ("ramIn1" <= terminal.type && terminal.type <= "ramIn8") || ("ramAddressIn1" <= terminal.type && terminal.type <= "ramAddressIn4") || terminal.type == "ramWriteEnable" || ("bus1" <= terminal.type && terminal.type <= "bus8") || ("counterIn1" <= terminal.type && terminal.type <= "counterIn4") || terminal.type == "counterClock" || terminal.type == "counterWriteEnable" || terminal.type == "counterCountEnable" || ("microcounterIn1" <= terminal.type && terminal.type <= "microcounterIn3") || ("IRIn1" <= terminal.type && terminal.type <= "IRIn8") || terminal.type == "IRWriteEnable" || ("displayIn1" <= terminal.type && terminal.type <= "displayIn8") || terminal.type == "displayWriteEnable" || ("decoderIn1" <= terminal.type && terminal.type <= "decoderIn9") || terminal.type == "clockHalt" || terminal.type == "aluSub" || ("flagsRegIn1" <= terminal.type && terminal.type <= "flagsRegIn2") || terminal.type == "flagsRegWriteEnable" || terminal.type == "microcounterReset")
-						{
-							smallestDistance = distance;
-							closestTerminalId = terminal.id;
-							closestTerminalPos = terminal.pos;
-						}
+		auto existing = std::find_if(catalog.begin(), catalog.end(), [&](const CatalogEntry& other) { return other.kind == entry.kind && other.key == entry.key; });
+		if (existing != catalog.end())
+			*existing = entry;
+		else
+			catalog.push_back(entry);
 
-						if (terminal.type == "transCollector")
-						{
-							needsNotOut = true;
-							transistorId = terminal.componentId;
-						}
-						else
-						{
-							needsNotOut = false;
-							transistorId = 0;
-						}
-					}
-				}
+		std::ofstream catalogFile("saves/catalog.txt", std::ios::app);
+		catalogFile << entry.line() << std::endl;
+	}
 
+	// Case insensitive match on name, key or kind, every word of the search has to appear.
+	std::vector<const CatalogEntry*> searchCatalog(std::string search)
+	{
+		loadCatalog();
 
-				if (smallestDistance < 10.00 && selectedTerminalA != closestTerminalId)
-				{
-					selectedTerminalB = closestTerminalId;
-					selectedTerminalBPos = closestTerminalPos;
-				}
+		auto lower = [](std::string text)
+		{
+			std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+			return text;
+		};
 
-			}
+		std::vector<std::string> words;
+		std::stringstream searchWords(lower(search));
+		for (std::string word; searchWords >> word;)
+			words.push_back(word);
 
+		std::vector<const CatalogEntry*> matches;
+		for (auto& entry : catalog)
+		{
+			std::string text = lower(entry.name + " " + entry.key + " " + entry.kind);
+			bool match = true;
 
-			if (selectedTerminalA && selectedTerminalB)
+			for (auto& word : words)
+				match = match && text.find(word) != std::string::npos;
+
+			if (match)
+				matches.push_back(&entry);
+		}
+
+		return matches;
+	}
+
+	void openCatalogEntry(const CatalogEntry& entry)
+	{
+		if (entry.kind == "save")
+			LoadInBackground(entry.key);
+		else
+		{
+			auto module = std::find(inventoryModules.begin(), inventoryModules.end(), entry.key);
+
+			if (module == inventoryModules.end())
 			{
-				int notOutTerminalId = 0;
+				inventoryModules.push_back(entry.key);
+				module = inventoryModules.end() - 1;
+			}
 
-				if (needsNotOut)
-					notOutTerminalId = lastTerminalId;
+			activeInventoryModule = int(module - inventoryModules.begin());
+			placingModule = true;
+		}
+	}
 
-				Connection newConnection = {
-					lastConnectionId,
-					selectedTerminalA,
-					selectedTerminalB,
-					selectedTerminalAPos,
-					selectedTerminalBPos,
-					notOutTerminalId,
-				};
-				lastConnectionId++;
-				connections.push_back(newConnection);
+	// --- History store ---------------------------------------------------------------------
+	// A design in the history store is one document: the four text save files, each after a [section] line.
 
-				if (needsNotOut)
-				{
-					olc::vi2d notOutPos = calculateNotOut(selectedTerminalAPos, selectedTerminalBPos);
-					terminals.push_back({ lastTerminalId, notOutPos, false, "transNotOut", transistorId });
-					lastTerminalId++;
-				}
+	static std::string textDocument(const std::vector<Component>& components, const std::vector<Terminal>& terminals, const std::vector<Connection>& connections, int lastTerminalId, int lastConnectionId, int lastComponentId)
+	{
+		std::stringstream document;
+		document << "[globals]\n" << lastTerminalId << "\n" << lastConnectionId << "\n" << lastComponentId << "\n";
 
-				updateSourceConnections();
-				updateSimulation = true;
+		document << "[components]\n";
+		for (auto& component : components)
+		{
+			document << component.id << "," << component.type << "," << component.pos.x << "," << component.pos.y;
 
-				selectedTerminalA = 0;
-				selectedTerminalB = 0;
-				selectedTerminalAPos = olc::vi2d(0, 0);
-				selectedTerminalBPos = olc::vi2d(0, 0);
-			}
+			if (component.width)
+				document << "," << component.width;
 
-			redrawRequired = true;
+			document << "\n";
 		}
 
-		if (GetKey(olc::Key::SPACE).bReleased)
+		document << "[connections]\n";
+		for (auto& connection : connections)
+			document << connection.id << "," << connection.terminalA << "," << connection.terminalB << "," << connection.terminalAPos.x << "," << connection.terminalAPos.y << "," << connection.terminalBPos.x << "," << connection.terminalBPos.y << "," << connection.notOutTerminal << "\n";
+
+		document << "[terminals]\n";
+		for (auto& terminal : terminals)
+			document << terminal.id << "," << terminal.pos.x << "," << terminal.pos.y << "," << terminal.type << "," << terminal.componentId << "\n";
+
+		return document.str();
+	}
+
+	std::string textDocument()
+	{
+		return textDocument(components, terminals, connections, lastTerminalId, lastConnectionId, lastComponentId);
+	}
+
+	// The files of a text save as they are on disk, with a newline added to any file that does not end in one.
+	static std::string readTextSave(std::string filepath)
+	{
+		std::string document;
+
+		for (std::string section : { "globals", "components", "connections", "terminals" })
 		{
-			if (activeInventoryComponent < (int)inventoryComponents.size() - 1)
-				activeInventoryComponent++;
-			else
-				activeInventoryComponent = 0;
+			std::ifstream file(filepath + section + ".txt", std::ios::binary);
+			document += "[" + section + "]\n";
+			document.append(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
 
-			redrawRequired = true;
+			if (document.back() != '\n')
+				document += "\n";
 		}
 
-		if (GetKey(olc::Key::A).bReleased)
+		return document;
+	}
+
+	// --- Spatial index -----------------------------------------------------------------------
+
+	// World rectangle a component draws into, from the sizes its Draw function uses.
+	void componentBounds(const Component& component, olc::vi2d& low, olc::vi2d& high)
+	{
+		olc::vi2d size = { 0, 0 };
+
+		if (component.type == "ALU")
+			size = { aluSize(componentWidth("ALU", 8)), aluSize(componentWidth("ALU", 8)) };
+		else if (component.type == "RAM")
+			size = { 215, 415 };
+		else if (component.type == "COUNTER")
+			size = { 25 * (componentWidth("COUNTER", 4) + 1), 50 };
+		else if (component.type == "MICROCOUNTER")
+			size = { 90, 50 };
+		else if (component.type == "IR")
+			size = { 240, 50 };
+		else if (component.type == "DECODER")
+			size = { 450, 60 };
+		else if (component.type == "FLAGSREG")
+			size = { 75, 60 };
+		else if (component.type == "DISPLAY")
+			size = { 405, 180 };
+
+		// Transistors, latches and LEDs are drawn around their position, labels can hang off the edges.
+		low = component.pos - olc::vi2d(50, 50);
+		high = component.pos + size + olc::vi2d(50, 50);
+
+		if (isModuleInstance(component))
 		{
-			if (selectedRamAddress < 15)
-				selectedRamAddress++;
-			else
-				selectedRamAddress = 0;
+			const ModuleDefinition* definition = moduleDefinition(component.type.substr(7));
+			low = component.pos + definition->boundsMin;
+			high = component.pos + definition->boundsMax;
+		}
+	}
 
-			updateSimulation = true;
-			redrawRequired = true;
+	void rebuildSpatialIndex()
+	{
+		spatialGrid.clear();
+		indexAppended(0, 0, 0);
+	}
+
+	void indexAppended(size_t componentCount, size_t terminalCount, size_t connectionCount)
+	{
+		// New parts change the static layer and the zoomed out tiles, and so does a full rebuild of the index.
+		staticLayerValid = false;
+		lodLevels.clear();
+		indicatorsValid = false;
+
+		if (!spatialGrid.valid)
+			return;
+
+		for (size_t i = componentCount; i < components.size(); i++)
+		{
+			olc::vi2d low, high;
+			componentBounds(components[i], low, high);
+			spatialGrid.addComponent((int)i, low, high);
 		}
 
-		if (GetKey(olc::Key::N).bReleased)
+		for (size_t i = terminalCount; i < terminals.size(); i++)
+			spatialGrid.addTerminal((int)i, terminals[i].pos);
+
+		wires.resize(connectionCount);
+		for (size_t i = connectionCount; i < connections.size(); i++)
+			wires.add(connections[i].terminalAPos, connections[i].terminalBPos);
+	}
+
+	void findVisible()
+	{
+		if (!spatialGrid.valid)
+			rebuildSpatialIndex();
+
+		olc::vf2d low, high;
+		pz.ScreenToWorld({ 0, 0 }, low);
+		pz.ScreenToWorld({ ScreenWidth(), ScreenHeight() }, high);
+
+		if (pz.GetScale().x < lodTileScale)
+			lodLevel().query(low, high, visibleTiles);
+		else
 		{
-			if (activeInventoryModule < (int)inventoryModules.size() - 1)
-				activeInventoryModule++;
-			else
-				activeInventoryModule = 0;
+			// Terminals are drawn as circles around their position.
+			spatialGrid.query(olc::vi2d(low) - olc::vi2d(10, 10), olc::vi2d(high) + olc::vi2d(10, 10), visibleComponents, visibleTerminals);
+			wires.transform(pz.GetOffset(), pz.GetScale(), { ScreenWidth(), ScreenHeight() });
+		}
 
-			redrawRequired = true;
+		if (tiledRendering)
+			binVisible();
+	}
+
+	// Sorts what findVisible found into the screen tiles it touches on screen, keeping the order it is drawn in.
+	void binVisible()
+	{
+		screenTileColumns = (ScreenWidth() + screenTileSize - 1) / screenTileSize;
+		int rows = (ScreenHeight() + screenTileSize - 1) / screenTileSize;
+		screenTiles.resize(screenTileColumns * rows);
+
+		for (int i = 0; i < (int)screenTiles.size(); i++)
+		{
+			ScreenTile& tile = screenTiles[i];
+			tile.low = olc::vi2d(i % screenTileColumns, i / screenTileColumns) * screenTileSize;
+			tile.high = tile.low + olc::vi2d(screenTileSize, screenTileSize);
+			tile.components.clear();
+			tile.terminals.clear();
+			tile.connections.clear();
+			tile.lodTiles.clear();
 		}
 
-		if (GetKey(olc::Key::M).bReleased)
+		auto bin = [&](olc::vi2d low, olc::vi2d high, std::vector<int> ScreenTile::* list, int index)
 		{
-			if (!placingModule)
-				placingModule = true;
-			else
-				placingModule = false;
+			int left = std::max(0, low.x / screenTileSize);
+			int top = std::max(0, low.y / screenTileSize);
+			int right = std::min(screenTileColumns - 1, high.x / screenTileSize);
+			int bottom = std::min(rows - 1, high.y / screenTileSize);
+
+			for (int y = top; y <= bottom; y++)
+				for (int x = left; x <= right; x++)
+					(screenTiles[y * screenTileColumns + x].*list).push_back(index);
+		};
 
-			redrawRequired = true;
+		if (pz.GetScale().x < lodTileScale)
+		{
+			const LodLevel& level = lodLevels[visibleLodBucket];
+
+			for (int index : visibleTiles)
+			{
+				olc::vi2d low, high;
+				pz.WorldToScreen(level.tiles[index].coordinates * level.tileSize, low);
+				pz.WorldToScreen((level.tiles[index].coordinates + olc::vi2d(1, 1)) * level.tileSize, high);
+				bin(low, high, &ScreenTile::lodTiles, index);
+			}
+
+			return;
 		}
 
-		if (placingModule)
-			redrawRequired = true;
+		for (int index : visibleComponents)
+		{
+			olc::vi2d low, high;
+			componentBounds(components[index], low, high);
+			pz.WorldToScreen(low, low);
+			pz.WorldToScreen(high, high);
 
-		if (GetKey(olc::Key::B).bReleased)
+			// Labels and the LED can reach a little past the bounds.
+			bin(low - olc::vi2d(16, 16), high + olc::vi2d(16, 16), &ScreenTile::components, index);
+		}
+
+		for (int index : visibleTerminals)
 		{
-			if (currentBusColumn < 8)
-				currentBusColumn++;
-			else
-				currentBusColumn = 1;
+			olc::vi2d pos;
+			pz.WorldToScreen(terminals[index].pos, pos);
+			bin(pos - olc::vi2d(4, 4), pos + olc::vi2d(4, 4), &ScreenTile::terminals, index);
+		}
 
-			redrawRequired = true;
+		for (int index : wires.onScreen)
+		{
+			olc::vi2d a = { wires.screenAX[index], wires.screenAY[index] };
+			olc::vi2d b = { wires.screenBX[index], wires.screenBY[index] };
+			bin(a.min(b), a.max(b), &ScreenTile::connections, index);
 		}
+	}
 
-		olc::vi2d sourceScreenPosition;
-		pz.WorldToScreen({ 0, 0 }, sourceScreenPosition);
+	// Zoom buckets are powers of two, a tile is lodTilePixels to twice that across on screen.
+	LodLevel& lodLevel()
+	{
+		visibleLodBucket = (int)std::floor(std::log2(pz.GetScale().x));
 
-		olc::vi2d clockScreenPosition;
-		pz.WorldToScreen({ -200, 0 }, clockScreenPosition);
+		auto level = lodLevels.find(visibleLodBucket);
+		if (level != lodLevels.end())
+			return level->second;
+
+		LodLevel& built = lodLevels[visibleLodBucket];
+		built.tileSize = std::max(1, int(lodTilePixels / std::exp2(visibleLodBucket)));
 
-		if (redrawRequired)
+		for (auto& component : components)
 		{
-			Clear(olc::BLACK);
+			olc::vi2d low, high;
+			componentBounds(component, low, high);
+			built.addComponent(low, high);
+		}
 
-			if (!componentBuilderMode)
-				DrawSource(sourceScreenPosition);
-			else
-				DrawCircle(sourceScreenPosition, 2, olc::DARK_GREY);
+		for (size_t i = 0; i < connections.size(); i++)
+			built.addConnection((int)i, connections[i].terminalAPos, connections[i].terminalBPos);
 
-			DrawClock(clockScreenPosition);
+		return built;
+	}
+
+	// Terminals, wires and components zoomed out past lodTileScale. The static pass shades each tile by how
+	// many wires cross it, or marks it as part of a component, the other pass by how many of them are on.
+	void DrawLodTiles(const std::vector<int>& indices, bool staticPass)
+	{
+		const LodLevel& level = lodLevels.at(visibleLodBucket);
+
+		for (int index : indices)
+		{
+			const LodLevel::Tile& tile = level.tiles[index];
+			olc::vi2d low, high;
+			pz.WorldToScreen(tile.coordinates * level.tileSize, low);
+			pz.WorldToScreen((tile.coordinates + olc::vi2d(1, 1)) * level.tileSize, high);
 
-			if (GetKey(olc::X).bHeld)
+			if (staticPass)
 			{
-				DrawLine({ GetMouseX(), 0 }, { GetMouseX(), ScreenHeight() }, { 64, 64, 64 }, 0xF0F0F0F0);
-				DrawLine({ 0, GetMouseY() }, { ScreenWidth(), GetMouseY() }, { 64, 64, 64 }, 0xF0F0F0F0);
-			}
+				if (tile.components)
+					FillRect(low, high - low, olc::DARK_BLUE);
+				else
+					FillRect(low, high - low, olc::PixelLerp(olc::VERY_DARK_GREY, olc::GREY, std::min(1.0f, tile.connections.size() / 8.0f)));
 
-			DrawTerminals();
-			DrawComponents();
-			DrawConnections();
-			
+				continue;
+			}
 
-			if (placingModule)
+			if (showActivity)
 			{
-				std::vector<olc::vi2d> ghostCoordinates = moduleCoordinates[activeInventoryModule];
-				std::vector<olc::vi2d> ghostCoordinatesScreen(ghostCoordinates.size());
+				uint32_t toggles = 0;
+				for (int connection : tile.connections)
+					toggles = std::max(toggles, connectionToggles[connection]);
 
-				for (int i = 0; i < ghostCoordinates.size(); i++)
-					pz.WorldToScreen(ghostCoordinates[i] + GetWorldMouse(), ghostCoordinatesScreen[i]);
+				if (toggles)
+					FillRect(low, high - low, activityColour(toggles, mostConnectionToggles));
 
-				if (ghostCoordinatesScreen.size() >= 4)
-				{
-					DrawLine(ghostCoordinatesScreen[0], ghostCoordinatesScreen[1], olc::GREY, 0xF0F0F0F0);
-					DrawLine(ghostCoordinatesScreen[0], ghostCoordinatesScreen[2], olc::GREY, 0xF0F0F0F0);
-					DrawLine(ghostCoordinatesScreen[1], ghostCoordinatesScreen[3], olc::GREY, 0xF0F0F0F0);
-					DrawLine(ghostCoordinatesScreen[2], ghostCoordinatesScreen[3], olc::GREY, 0xF0F0F0F0);
-				}
+				continue;
 			}
 
-			DrawStrings();
-			redrawRequired = false;
-		}
+			int on = 0;
+			for (int connection : tile.connections)
+				on += connections[connection].state;
 
-		return !(GetKey(olc::ESCAPE).bPressed);
+			// Inset over a component so the box still shows.
+			if (on && tile.components)
+				FillRect(low + (high - low) / 4, (high - low) / 2, olc::PixelLerp(olc::DARK_GREEN, olc::GREEN, on / (float)tile.connections.size()));
+			else if (on)
+				FillRect(low, high - low, olc::PixelLerp(olc::DARK_GREEN, olc::GREEN, on / (float)tile.connections.size()));
+		}
 	}
 
-private:
-	olc::panzoom pz;
-	bool clockState = false;
-	int clockSpeed = 0;
-	int clockTicks = 0;
-	bool risingEdge = false;
-	bool fallingEdge = false;
-	std::vector<Component> components;
-	std::vector<Connection> connections;
-	std::vector<Connection*> sourceConnections;
-	std::vector<Terminal> terminals;
-	int lastTerminalId = 4;
-	int lastConnectionId = 1;
-	int lastComponentId = 2;
-	int selectedTerminalA = 0;
-	int selectedTerminalB = 0;
-	olc::vi2d selectedTerminalAPos;
-	olc::vi2d selectedTerminalBPos;
-	int activeInventoryComponent = 0;
-	std::vector<std::string> inventoryComponents = {
-		"DISPLAY",
-		"BUFFER",
-		"LED",
-		"FLAGSREG",
-		"TRANSISTOR",
-		"GATED LATCH",
-		"DECODER",
-		"MICROCOUNTER",
-		"IR",
-		"BUSTERM",
-		"ALU",
-		"COUNTER",
-		"RAM",
-	};
-	int activeInventoryModule = 0;
-	bool placingModule = false;
-	std::vector<std::vector<olc::vi2d>> moduleCoordinates = {
-		{{-53, -88}, {60, -88}, {-53, 76}, {60, 76}},         // AND
-		{{-101, -48}, {97, -48}, {-101, 51}, {97, 51}},       // OR
-		{{-53, -90}, {158, -90}, {-53, 76}, {158, 76}},       // NAND
-		{{-151, -130}, {241, -130}, {-151, 191}, {241, 191}}, // XOR
-		{{-481, -265}, {468, -265}, {-481, 302}, {468, 302}}, // ADDER
-		{{-355, -187}, {354, -187}, {-355, 177}, {354, 177}}, // REG
-		{{-101, -48}, {97, -48}, {-101, 51}, {97, 51}},       // BITS
-		{{-339, 103}, {800, 103}, {-339, 520}, {800, 520}},   // REGBUS
-		{{-377, 103}, {800, 103}, {-377, 932}, {800, 932}}    // REGS
-	};
-	std::vector<std::string> inventoryModules = {
-		"AND",
-		"OR",
-		"NAND",
-		"XOR",
-		"ADDER",
-		"REG",
-		"BITS",
-		"REGBUS",
-		"REGS",
-	};
-	bool simulationPaused = false;
-	bool updateSimulation = false;
-	bool componentBuilderMode = false;
-	bool redrawRequired = true;
-	bool ramFixMode = true;
-	bool showInfo = false;
-	bool startZooming = false;
-	int aluA = 0;
-	int aluB = 0;
-	int aluO = 0;
-	int selectedRamAddress = 0;
-	std::vector<std::vector<int>> ramContents = loadProgram("fibonacci");
-	int currentBusColumn = 1;
-	std::vector<int> IRContents = { 0, 0, 0, 0, 0, 0, 0, 0 };
-	std::vector<int> displayContents = { 0, 0, 0, 0, 0, 0, 0, 0 };
-	std::vector<int> decoderContents = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
-	std::vector<int> flagsRegContents = { 0, 0 };
-	int counterValue = 0;
-	int microcounterValue = 0;
-	bool counterCounted = false;
-	bool microcounterCounted = false;
-
-	void Save()
+	// Everything on the canvas for one pass, with less detail the further out the view is zoomed.
+	void DrawCircuit(bool staticPass)
 	{
-		std::string timestamp = std::to_string(std::time(0));
-		std::string filepath = "saves/" + timestamp + "_";
-
-		std::string globalsFilepath = filepath + "globals.txt";
-		std::ofstream globalsFile(globalsFilepath);
-		globalsFile << lastTerminalId << std::endl;
-		globalsFile << lastConnectionId << std::endl;
-		globalsFile << lastComponentId << std::endl;
+		if (!indicatorsValid)
+		{
+			indicatorTerminals = findIndicatorTerminals(components, terminals);
+			indicatorsValid = true;
+		}
 
+		for (int index : visibleComponents)
+			if (!staticPass && components[index].type == "DISPLAY")
+				prepareDisplayGlyphs();
 
-		std::string componentsFilepath = filepath + "components.txt";
-		std::ofstream componentsFile(componentsFilepath);
+		if (showActivity && !staticPass)
+			refreshActivity();
 
-		for (auto component : components)
+		if (!tiledRendering)
 		{
-			componentsFile << component.id << "," << component.type << ",";
-			componentsFile << component.pos.x << "," << component.pos.y << std::endl;
+			DrawCircuit(visibleComponents, visibleTerminals, wires.onScreen, visibleTiles, staticPass);
+			return;
 		}
 
-		std::string connectionsFilepath = filepath + "connections.txt";
-		std::ofstream connectionsFile(connectionsFilepath);
+		if (renderPool.threads.empty())
+			renderPool.start(std::max(1, (int)std::thread::hardware_concurrency() - 1));
 
-		for (auto connection : connections)
+		// Each tile draws everything that touches it in the same order as the whole screen would, clipped to
+		// the tile, so the result is the same to the pixel.
+		renderPool.run((int)screenTiles.size(), [&](int index)
 		{
-			connectionsFile << connection.id << "," << connection.terminalA << ",";
-			connectionsFile << connection.terminalB << ",";
-			connectionsFile << connection.terminalAPos.x << "," << connection.terminalAPos.y << ",";
-			connectionsFile << connection.terminalBPos.x << "," << connection.terminalBPos.y << ",";
-			connectionsFile << connection.notOutTerminal << std::endl;
-		}
-
-		std::string terminalsFilepath = filepath + "terminals.txt";
-		std::ofstream terminalsFile(terminalsFilepath);
+			const ScreenTile& tile = screenTiles[index];
+			drawClipLow = tile.low;
+			drawClipHigh = tile.high;
+			DrawCircuit(tile.components, tile.terminals, tile.connections, tile.lodTiles, staticPass);
+			drawClipLow = { INT_MIN, INT_MIN };
+			drawClipHigh = { INT_MAX, INT_MAX };
+		});
+	}
 
-		for (auto terminal : terminals)
+	void DrawCircuit(const std::vector<int>& componentIndices, const std::vector<int>& terminalIndices, const std::vector<int>& connectionIndices, const std::vector<int>& tileIndices, bool staticPass)
+	{
+		if (pz.GetScale().x < lodTileScale)
 		{
-			terminalsFile << terminal.id << "," << terminal.pos.x << "," << terminal.pos.y << ",";
-			terminalsFile << terminal.type << "," << terminal.componentId << std::endl;
+			DrawLodTiles(tileIndices, staticPass);
+			return;
 		}
+
+		// Terminals would be a pixel or two across.
+		if (pz.GetScale().x >= lodTerminalScale)
+			DrawTerminals(terminalIndices, staticPass);
+
+		DrawComponents(componentIndices, staticPass);
+		DrawConnections(connectionIndices, staticPass);
+
+		if (showActivity && !staticPass)
+			DrawActivity(componentIndices, connectionIndices);
 	}
 
-	void PlaceModule(std::string module_name)
+	// Over the lit state, anything that switched goes from yellow to red for the busiest, on a log scale as a
+	// few clock lines switch far more often than the rest.
+	void DrawActivity(const std::vector<int>& componentIndices, const std::vector<int>& connectionIndices)
 	{
-		std::string filepath = "modules/" + module_name + "_";
+		for (int index : connectionIndices)
+			if (connectionToggles[index])
+				DrawLine(wires.screenAX[index], wires.screenAY[index], wires.screenBX[index], wires.screenBY[index], activityColour(connectionToggles[index], mostConnectionToggles));
 
-		std::ifstream componentsFile(filepath + "components.txt");
-		std::string rawId;
-		std::string rawType;
-		std::string rawPosX;
-		std::string rawPosY;
-		int lastComponentIdOffset = 0;
-
-		while (std::getline(componentsFile, rawId, ','))
-		{
-			std::getline(componentsFile, rawType, ',');
-			std::getline(componentsFile, rawPosX, ',');
-			std::getline(componentsFile, rawPosY, '\n');
-
-			components.push_back({ stoi(rawId) + lastComponentId, rawType, olc::vi2d(stoi(rawPosX), stoi(rawPosY)) + GetWorldMouse() });
-			lastComponentIdOffset = stoi(rawId);
-		}
-
-		std::ifstream connectionsFile(filepath + "connections.txt");
-		std::string rawConnectionId;
-		std::string rawTerminalA;
-		std::string rawTerminalB;
-		std::string rawTerminalAPosX;
-		std::string rawTerminalAPosY;
-		std::string rawTerminalBPosX;
-		std::string rawTerminalBPosY;
-		std::string rawNotOutTerminal;
-		int lastConnectionIdOffset = 0;
-
-		while (std::getline(connectionsFile, rawConnectionId, ','))
-		{
-			std::getline(connectionsFile, rawTerminalA, ',');
-			std::getline(connectionsFile, rawTerminalB, ',');
-			std::getline(connectionsFile, rawTerminalAPosX, ',');
-			std::getline(connectionsFile, rawTerminalAPosY, ',');
-			std::getline(connectionsFile, rawTerminalBPosX, ',');
-			std::getline(connectionsFile, rawTerminalBPosY, ',');
-			std::getline(connectionsFile, rawNotOutTerminal, '\n');
-
-			connections.push_back({
-				stoi(rawConnectionId) + lastConnectionId,
-				stoi(rawTerminalA) + lastTerminalId,
-				stoi(rawTerminalB) + lastTerminalId,
-				olc::vi2d(stoi(rawTerminalAPosX), stoi(rawTerminalAPosY)) + GetWorldMouse(),
-				olc::vi2d(stoi(rawTerminalBPosX), stoi(rawTerminalBPosY)) + GetWorldMouse(),
-				stoi(rawNotOutTerminal) + lastTerminalId
-				});
-
-			lastConnectionIdOffset = stoi(rawConnectionId);
-		}
-
-		std::ifstream terminalsFile(filepath + "terminals.txt");
-		std::string rawTerminalId;
-		std::string rawTerminalPosX;
-		std::string rawTerminalPosY;
-		std::string rawTerminalType;
-		std::string rawTerminalComponentId;
-		int lastTerminalIdOffset = 0;
-
-		while (std::getline(terminalsFile, rawTerminalId, ','))
-		{
-			std::getline(terminalsFile, rawTerminalPosX, ',');
-			std::getline(terminalsFile, rawTerminalPosY, ',');
-			std::getline(terminalsFile, rawTerminalType, ',');
-			std::getline(terminalsFile, rawTerminalComponentId, '\n');
-
-			terminals.push_back({
-				stoi(rawTerminalId) + lastTerminalId,
-				olc::vi2d(stoi(rawTerminalPosX), stoi(rawTerminalPosY)) + GetWorldMouse(),
-				false,
-				rawTerminalType,
-				stoi(rawTerminalComponentId) + lastComponentId,
-				});
-
-			lastTerminalIdOffset = stoi(rawTerminalId);
-		}
-
-
-		lastComponentId += lastComponentIdOffset + 1;
-		lastConnectionId += lastConnectionIdOffset + 1;
-		lastTerminalId += lastTerminalIdOffset + 1;
-		
+		for (int index : componentIndices)
+			if (componentToggles[index])
+			{
+				olc::vi2d componentScreenPos;
+				pz.WorldToScreen(components[index].pos, componentScreenPos);
+				DrawLed(componentScreenPos, activityColour(componentToggles[index], mostComponentToggles));
+			}
 	}
 
-	void Load()
+	static olc::Pixel activityColour(uint32_t toggles, uint32_t most)
 	{
-		// Full Computer   1634261839
-		// Full Demo       1634296642
-		// ALU Testing     1634172481
-		// RAM Testing     1634283966
-		std::string load_timestamp = "1634261839";
-		std::string filepath = "saves/" + load_timestamp + "_";
-		std::ifstream globalsFile(filepath + "globals.txt");
+		return olc::PixelLerp(olc::YELLOW, olc::RED, std::log1p((float)toggles) / std::log1p((float)std::max(1u, most)));
+	}
 
-		int currentLine = 0;
-		if (globalsFile.is_open())
-		{
-			std::string line;
+	bool Draw(int32_t x, int32_t y, olc::Pixel p = olc::WHITE) override
+	{
+		if (x < drawClipLow.x || y < drawClipLow.y || x >= drawClipHigh.x || y >= drawClipHigh.y)
+			return false;
 
-			while (std::getline(globalsFile, line))
-			{
-				if (currentLine == 0)
-				{
-					lastTerminalId = std::stoi(line);
-				}
-				if (currentLine == 1)
-				{
-					lastConnectionId = std::stoi(line);
-				}
-				if (currentLine == 2)
-				{
-					lastComponentId = std::stoi(line);
-				}
+		return olc::PixelGameEngine::Draw(x, y, p);
+	}
 
-				currentLine++;
-			}
+	using olc::PixelGameEngine::Draw;
 
-			globalsFile.close();
+	// Copies the cached static layer to the screen, redrawing it first when the view or the design changed.
+	// Clear and the state-coloured passes on top replace what used to be drawn each frame.
+	void DrawStaticLayer()
+	{
+		olc::Sprite* screen = GetDrawTarget();
+
+		if (!staticLayer || staticLayer->width != screen->width || staticLayer->height != screen->height)
+		{
+			staticLayer = std::make_unique<olc::Sprite>(screen->width, screen->height);
+			staticLayerValid = false;
 		}
 
-		components.clear();
-		std::ifstream componentsFile(filepath + "components.txt");
-		std::string rawId;
-		std::string rawType;
-		std::string rawPosX;
-		std::string rawPosY;
+		if (pz.GetOffset() != staticLayerOffset || pz.GetScale() != staticLayerScale)
+			staticLayerValid = false;
 
-		while (std::getline(componentsFile, rawId, ','))
+		if (!staticLayerValid)
 		{
-			std::getline(componentsFile, rawType, ',');
-			std::getline(componentsFile, rawPosX, ',');
-			std::getline(componentsFile, rawPosY, '\n');
+			SetDrawTarget(staticLayer.get());
+			Clear(olc::BLACK);
+			DrawCircuit(true);
+			SetDrawTarget(screen);
 
-			components.push_back({ stoi(rawId), rawType, olc::vi2d(stoi(rawPosX), stoi(rawPosY)) });
+			staticLayerOffset = pz.GetOffset();
+			staticLayerScale = pz.GetScale();
+			staticLayerValid = true;
 		}
 
-		connections.clear();
-		std::ifstream connectionsFile(filepath + "connections.txt");
-		std::string rawConnectionId;
-		std::string rawTerminalA;
-		std::string rawTerminalB;
-		std::string rawTerminalAPosX;
-		std::string rawTerminalAPosY;
-		std::string rawTerminalBPosX;
-		std::string rawTerminalBPosY;
-		std::string rawNotOutTerminal;
-
-		while (std::getline(connectionsFile, rawConnectionId, ','))
-		{
-			std::getline(connectionsFile, rawTerminalA, ',');
-			std::getline(connectionsFile, rawTerminalB, ',');
-			std::getline(connectionsFile, rawTerminalAPosX, ',');
-			std::getline(connectionsFile, rawTerminalAPosY, ',');
-			std::getline(connectionsFile, rawTerminalBPosX, ',');
-			std::getline(connectionsFile, rawTerminalBPosY, ',');
-			std::getline(connectionsFile, rawNotOutTerminal, '\n');
-
-			connections.push_back({
-				stoi(rawConnectionId),
-				stoi(rawTerminalA),
-				stoi(rawTerminalB),
-				olc::vi2d({ stoi(rawTerminalAPosX), stoi(rawTerminalAPosY) }),
-				olc::vi2d({ stoi(rawTerminalBPosX), stoi(rawTerminalBPosY) }),
-				stoi(rawNotOutTerminal)
-				});
-		}
+		std::copy(staticLayer->pColData.begin(), staticLayer->pColData.end(), screen->pColData.begin());
+	}
 
-		terminals.clear();
-		std::ifstream terminalsFile(filepath + "terminals.txt");
-		std::string rawTerminalId;
-		std::string rawTerminalPosX;
-		std::string rawTerminalPosY;
-		std::string rawTerminalType;
-		std::string rawTerminalComponentId;
+	// The static pass draws bodies and everything in its off colour, the other pass only what is lit
+	// or shows values.
+	// By component, the indices of the terminals that light its LED: any of an LED's, a gated latch's output.
+	static std::vector<std::vector<int>> findIndicatorTerminals(const std::vector<Component>& components, const std::vector<Terminal>& terminals)
+	{
+		std::vector<std::vector<int>> indicators(components.size());
+		std::unordered_map<int, int> componentIndices;
 
-		while (std::getline(terminalsFile, rawTerminalId, ','))
+		for (int i = 0; i < (int)components.size(); i++)
+			componentIndices[components[i].id] = i;
+
+		for (int i = 0; i < (int)terminals.size(); i++)
 		{
-			std::getline(terminalsFile, rawTerminalPosX, ',');
-			std::getline(terminalsFile, rawTerminalPosY, ',');
-			std::getline(terminalsFile, rawTerminalType, ',');
-			std::getline(terminalsFile, rawTerminalComponentId, '\n');
+			auto component = componentIndices.find(terminals[i].componentId);
 
-			terminals.push_back({
-				stoi(rawTerminalId),
-				olc::vi2d({ stoi(rawTerminalPosX), stoi(rawTerminalPosY) }),
-				false,
-				rawTerminalType,
-				stoi(rawTerminalComponentId),
-				});
+			if (component != componentIndices.end() && (components[component->second].type == "LED" || terminals[i].type == "gatedOut"))
+				indicators[component->second].push_back(i);
 		}
 
-		updateSourceConnections();
-		updateSimulation = true;
+		return indicators;
+	}
+
+	bool indicatorOn(int componentIndex)
+	{
+		for (int terminal : indicatorTerminals[componentIndex])
+			if (terminals[terminal].state)
+				return true;
+
+		return false;
 	}
 
-	void DrawComponents()
+	void DrawComponents(const std::vector<int>& indices, bool staticPass)
 	{
-		for (auto component : components)
+		for (int index : indices)
 		{
+			const Component& component = components[index];
 			olc::vi2d componentWorldPos = component.pos;
 			olc::vi2d componentScreenPos;
 			pz.WorldToScreen(componentWorldPos, componentScreenPos);
 
-			if (component.type == "TRANSISTOR")
-				DrawTransistor(componentScreenPos);
+			if (isModuleInstance(component))
+				DrawModuleInstance(component, staticPass);
 
-			if (component.type == "GATED LATCH")
+			if (staticPass)
 			{
-				DrawGatedLatch(componentScreenPos);
-
+				if (component.type == "TRANSISTOR")
+					DrawTransistor(componentScreenPos);
 
-				olc::Pixel ledColour = olc::VERY_DARK_RED;
-
-				for (auto terminal : terminals)
+				if (component.type == "GATED LATCH")
 				{
-					if (terminal.componentId == component.id && terminal.type == "gatedOut" && terminal.state)
-					{
-						ledColour = olc::RED;
-						break;
-					}
+					DrawGatedLatch(componentScreenPos);
+					DrawLed(componentScreenPos, olc::VERY_DARK_RED);
 				}
 
-				DrawLed(componentScreenPos, ledColour);
+				if (component.type == "LED")
+					DrawLed(componentScreenPos, olc::VERY_DARK_GREEN);
+
+				continue;
 			}
 
+			if (component.type == "GATED LATCH" && indicatorOn(index))
+				DrawLed(componentScreenPos, olc::RED);
+
 			if (component.type == "ALU")
 			{
 				DrawALU(componentScreenPos);
@@ -1482,48 +6265,103 @@ private:
 				DrawDisplay(componentScreenPos);
 			}
 
-			if (component.type == "LED")
+			if (component.type == "LED" && indicatorOn(index))
+				DrawLed(componentScreenPos, olc::GREEN);
+		}
+	}
+
+	// The inside of a module instance, drawn from its definition and coloured by the instance's node values.
+	void DrawModuleInstance(const Component& instance, bool staticPass)
+	{
+		const ModuleDefinition* definition = moduleDefinition(instance.type.substr(7));
+		// Looked up without inserting, the tiled renderer draws instances from several threads.
+		static const std::vector<uint8_t> noValues;
+		auto state = moduleStates.find(instance.id);
+		const std::vector<uint8_t>& values = state != moduleStates.end() ? state->second : noValues;
+
+		auto terminalState = [&](int terminalId)
+		{
+			auto index = definition->terminalIndices.find(terminalId);
+			if (index == definition->terminalIndices.end())
+				return false;
+
+			size_t node = definition->netlist.terminalNodes[index->second];
+			return node < values.size() && values[node];
+		};
+
+		for (auto& connection : definition->connections)
+		{
+			olc::vi2d terminalAScreenPos;
+			olc::vi2d terminalBScreenPos;
+			pz.WorldToScreen(connection.terminalAPos + instance.pos, terminalAScreenPos);
+			pz.WorldToScreen(connection.terminalBPos + instance.pos, terminalBScreenPos);
+
+			if (staticPass)
+				DrawLine(terminalAScreenPos, terminalBScreenPos, olc::DARK_GREY);
+			else if (terminalState(connection.terminalA))
+				DrawLine(terminalAScreenPos, terminalBScreenPos, olc::GREEN);
+		}
+
+		for (size_t i = 0; i < definition->components.size(); i++)
+		{
+			const Component& component = definition->components[i];
+			olc::vi2d componentScreenPos;
+			pz.WorldToScreen(component.pos + instance.pos, componentScreenPos);
+
+			if (staticPass)
 			{
-				olc::Pixel ledColour = olc::VERY_DARK_GREEN;
+				if (component.type == "TRANSISTOR")
+					DrawTransistor(componentScreenPos);
 
-				for (auto terminal : terminals)
+				if (component.type == "GATED LATCH")
 				{
-					if (terminal.componentId == component.id && terminal.state)
-					{
-						ledColour = olc::GREEN;
-						break;
-					}
+					DrawGatedLatch(componentScreenPos);
+					DrawLed(componentScreenPos, olc::VERY_DARK_RED);
 				}
 
-				DrawLed(componentScreenPos, ledColour);
+				if (component.type == "LED")
+					DrawLed(componentScreenPos, olc::VERY_DARK_GREEN);
+
+				continue;
 			}
+
+			bool on = false;
+			for (int terminal : definition->indicatorTerminals[i])
+				on = on || terminalState(definition->terminals[terminal].id);
+
+			if (on)
+				DrawLed(componentScreenPos, component.type == "LED" ? olc::GREEN : olc::RED);
 		}
 	}
 
-	void DrawConnections()
+	void DrawConnections(const std::vector<int>& indices, bool staticPass)
 	{
-		for (auto connection : connections)
+		for (int index : indices)
 		{
-			olc::Pixel colour = olc::DARK_GREY;
-			olc::vi2d terminalAWorldPos = connection.terminalAPos;
-			olc::vi2d terminalAScreenPos;
-			pz.WorldToScreen(terminalAWorldPos, terminalAScreenPos);
-			olc::vi2d terminalBWorldPos = connection.terminalBPos;
-			olc::vi2d terminalBScreenPos;
-			pz.WorldToScreen(terminalBWorldPos, terminalBScreenPos);
+			const Connection& connection = connections[index];
+
+			if (!staticPass && !connection.state)
+				continue;
 
+			olc::Pixel colour = olc::DARK_GREY;
 
-			if (connection.state)
+			if (connection.state && !staticPass)
 				colour = olc::GREEN;
 
-			DrawLine(terminalAScreenPos, terminalBScreenPos, colour);
+			DrawLine(wires.screenAX[index], wires.screenAY[index], wires.screenBX[index], wires.screenBY[index], colour);
 		}
 	}
 
-	void DrawTerminals()
+	void DrawTerminals(const std::vector<int>& indices, bool staticPass)
 	{
-		for (auto terminal : terminals)
+		for (int index : indices)
 		{
+			const Terminal& terminal = terminals[index];
+			bool selected = selectedTerminalA == terminal.id || selectedTerminalB == terminal.id;
+
+			if (!staticPass && !terminal.state && !selected)
+				continue;
+
 			olc::vi2d terminalWorldPos = terminal.pos;
 			olc::vi2d terminalScreenPos;
 
@@ -1541,10 +6379,10 @@ private:
 				// DrawString(terminalScreenPos + olc::vi2d(5, 15), busColumnStringNumber, olc::WHITE);
 			}
 
-			if (terminal.state)
+			if (terminal.state && !staticPass)
 				colour = olc::GREEN;
 
-			if (selectedTerminalA == terminal.id || selectedTerminalB == terminal.id)
+			if (selected && !staticPass)
 				colour = olc::MAGENTA;
 
 			DrawTerminal(terminalScreenPos, colour);
@@ -1552,20 +6390,80 @@ private:
 		}
 	}
 
+	// Min, average and 99th percentile of each series over the profiler's history.
+	void DrawProfile(olc::vi2d pos)
+	{
+		std::ostringstream header;
+		header << std::left << std::setw(20) << "MS PER FRAME" << std::right << std::setw(8) << "MIN" << std::setw(8) << "AVG" << std::setw(8) << "P99";
+		DrawString(pos, header.str(), olc::CYAN);
+
+		for (int series = 0; series < Profiler::SERIES_COUNT; series++)
+		{
+			if (series == Profiler::timedSeries)
+			{
+				pos.y += 20;
+				DrawString(pos, "PER SETTLE", olc::CYAN);
+			}
+
+			double low, average, p99;
+			profiler.stats(series, low, average, p99);
+
+			std::ostringstream line;
+			line << std::left << std::setw(20) << Profiler::names[series] << std::right << std::fixed << std::setprecision(series < Profiler::timedSeries ? 2 : 0)
+				<< std::setw(8) << low << std::setw(8) << average << std::setw(8) << p99;
+
+			pos.y += 12;
+			DrawString(pos, line.str(), olc::WHITE);
+		}
+	}
+
 	void DrawStrings()
 	{
 		std::string offsetString = std::to_string(int(pz.GetOffset().x)) + ", " + std::to_string(int(pz.GetOffset().y));
 
 		DrawString(olc::vi2d(50, 50), offsetString, olc::DARK_GREY);
 
+		if (loading)
+			DrawString(olc::vi2d(250, 50), "LOADING " + loadingDesign + " " + std::to_string(int(loader->loadProgress * 100)) + "%", olc::YELLOW);
+		else if (saving)
+			DrawString(olc::vi2d(250, 50), "SAVING " + savingDesign, olc::YELLOW);
+
 		if (!placingModule)
-			DrawString(olc::vi2d(50, 70), inventoryComponents[activeInventoryComponent], olc::GREEN);
+		{
+			std::string inventoryString = inventoryComponents[activeInventoryComponent];
+			int width = placementWidth(inventoryString);
+
+			if (width && inventoryString == "RAM")
+				inventoryString += " " + std::to_string(1 << width) + " BYTES";
+			else if (width)
+				inventoryString += " " + std::to_string(width) + "-BIT";
+
+			DrawString(olc::vi2d(50, 70), inventoryString, olc::GREEN);
+		}
 		else
 			DrawString(olc::vi2d(50, 70), inventoryModules[activeInventoryModule], olc::GREEN);
 
 		if (simulationPaused)
 			DrawString(olc::vi2d(50, 90), "PAUSED", olc::RED);
 
+		std::string rates = std::to_string(int(measuredFps + 0.5)) + " FPS  " + std::to_string((long long)(measuredHz + 0.5)) + " HZ";
+		DrawString(olc::vi2d(ScreenWidth() - 50 - 8 * (int)rates.size(), 50), rates, olc::DARK_GREY);
+
+		if (showActivity)
+		{
+			std::string activity = "ACTIVITY OVER " + std::to_string(clockCycles - activityStartCycles) + " CYCLES";
+			DrawString(olc::vi2d(ScreenWidth() - 50 - 8 * (int)activity.size(), 70), activity, olc::YELLOW);
+		}
+
+		if (profiler.enabled)
+			DrawProfile(olc::vi2d(ScreenWidth() - 50 - 8 * 44, 110));
+
+		if (tiledRendering)
+			DrawString(olc::vi2d(50, 30), "TILED ON " + std::to_string(renderPool.threads.size() + 1) + " THREADS", olc::DARK_GREY);
+
+		if (emulatorStatus.size())
+			DrawString(olc::vi2d(150, 90), emulatorStatus, olc::YELLOW);
+
 		int startY = 110;
 		int spacer = 20;
 
@@ -1606,6 +6504,71 @@ private:
 	}
 
 
+	void updateCatalogBrowser()
+	{
+		std::vector<const CatalogEntry*> matches = searchCatalog(catalogSearch);
+
+		for (int key = olc::A; key <= olc::Z; key++)
+			if (GetKey(olc::Key(key)).bPressed)
+				catalogSearch += char('a' + key - olc::A);
+
+		for (int key = olc::K0; key <= olc::K9; key++)
+			if (GetKey(olc::Key(key)).bPressed)
+				catalogSearch += char('0' + key - olc::K0);
+
+		if (GetKey(olc::SPACE).bPressed)
+			catalogSearch += ' ';
+
+		if (GetKey(olc::BACK).bPressed && catalogSearch.size())
+			catalogSearch.pop_back();
+
+		if (GetKey(olc::Key::UP).bPressed && catalogSelection > 0)
+			catalogSelection--;
+
+		if (GetKey(olc::Key::DOWN).bPressed && catalogSelection + 1 < (int)matches.size())
+			catalogSelection++;
+
+		if (GetKey(olc::ENTER).bPressed || GetKey(olc::RETURN).bPressed)
+		{
+			if (catalogSelection < (int)matches.size())
+				openCatalogEntry(*matches[catalogSelection]);
+
+			catalogOpen = false;
+		}
+
+		for (int key = olc::A; key <= olc::ENTER; key++)
+			if (GetKey(olc::Key(key)).bPressed)
+				redrawRequired = true;
+
+		catalogSelection = std::max(0, std::min(catalogSelection, (int)searchCatalog(catalogSearch).size() - 1));
+	}
+
+	void DrawCatalog()
+	{
+		std::vector<const CatalogEntry*> matches = searchCatalog(catalogSearch);
+		const int rowHeight = 20;
+		int rows = (ScreenHeight() - 100) / rowHeight;
+		int first = std::max(0, catalogSelection - rows / 2);
+
+		DrawString(olc::vi2d(50, 30), "OPEN: " + catalogSearch + "_", olc::GREEN);
+		DrawString(olc::vi2d(50, 50), std::to_string(matches.size()) + " of " + std::to_string(catalog.size()) + ", UP/DOWN ENTER, TAB closes", olc::DARK_GREY);
+
+		for (int row = 0; row < rows && first + row < (int)matches.size(); row++)
+		{
+			const CatalogEntry& entry = *matches[first + row];
+			olc::vi2d rowPos(50, 80 + row * rowHeight);
+			bool selected = first + row == catalogSelection;
+
+			for (int y = 0; y < CatalogEntry::thumbnailHeight; y++)
+				for (int x = 0; x < CatalogEntry::thumbnailWidth; x++)
+					FillRect(rowPos + olc::vi2d(x * 2, y * 2), olc::vi2d(2, 2), entry.thumbnailCell(x, y) ? olc::GREEN : olc::VERY_DARK_GREY);
+
+			std::string details = entry.kind + " " + entry.key + ", " + std::to_string(entry.components) + " components";
+			DrawString(rowPos + olc::vi2d(45, 0), entry.name, selected ? olc::MAGENTA : olc::WHITE);
+			DrawString(rowPos + olc::vi2d(45 + 8 * std::max(20, (int)entry.name.size() + 2), 0), details, olc::DARK_GREY);
+		}
+	}
+
 	void DrawTransistor(olc::vi2d pos)
 	{
 		int size = 25 * pz.GetScale().x;
@@ -1624,15 +6587,15 @@ private:
 	void DrawALU(olc::vi2d pos)
 	{
 		float scale = pz.GetScale().x;
-		int squareWidth = 300 * scale;
+		int squareWidth = aluSize(componentWidth("ALU", 8)) * scale;
 		DrawRect(pos, { squareWidth, squareWidth }, olc::WHITE);
 
 		if (scale > 0.6)
-			DrawString(pos + olc::vf2d(squareWidth / 2 - 40, squareWidth / 2), "VISCOM ALU", olc::DARK_GREY);
+			DrawLabel(pos + olc::vf2d(squareWidth / 2 - 40, squareWidth / 2), "VISCOM ALU", olc::DARK_GREY);
 
-		DrawString(pos + olc::vf2d(squareWidth / 2, squareWidth / 8), std::to_string(aluA), olc::GREEN);
-		DrawString(pos + olc::vf2d(squareWidth / 2, squareWidth / 8 * 7), std::to_string(aluB), olc::GREEN);
-		DrawString(pos + olc::vf2d(squareWidth / 8, squareWidth / 2), std::to_string(aluO), olc::GREEN);
+		DrawLabel(pos + olc::vf2d(squareWidth / 2, squareWidth / 8), std::to_string(aluA), olc::GREEN);
+		DrawLabel(pos + olc::vf2d(squareWidth / 2, squareWidth / 8 * 7), std::to_string(aluB), olc::GREEN);
+		DrawLabel(pos + olc::vf2d(squareWidth / 8, squareWidth / 2), std::to_string(aluO), olc::GREEN);
 	}
 
 	void DrawRAM(olc::vi2d pos)
@@ -1643,11 +6606,15 @@ private:
 		float bitPadding = 25 * scale;
 		float ramToBitsPadding = 20 * scale;
 		DrawRect(pos, { ramWidth, ramHeight }, olc::WHITE);
-		for (int ramAddress = 0; ramAddress < ramContents.size(); ramAddress++)
+
+		// Larger RAMs only show the 16 byte window around the selected address.
+		int firstAddress = ramWindowStart();
+
+		for (int ramAddress = firstAddress; ramAddress < firstAddress + ramWindowRows(); ramAddress++)
 		{
-			for (int ramBit = 0; ramBit < ramContents[0].size(); ramBit++)
+			for (int ramBit = 0; ramBit < 8; ramBit++)
 			{
-				int thisBit = ramContents[ramAddress][ramBit];
+				int thisBit = ramContents.readBit(ramAddress, ramBit);
 				olc::Pixel ramBitColor = olc::VERY_DARK_RED;
 
 				if (thisBit)
@@ -1655,57 +6622,43 @@ private:
 					ramBitColor = olc::RED;
 				}
 
-				DrawLed(pos + olc::vf2d(ramToBitsPadding + ramBit * bitPadding, ramToBitsPadding + ramAddress * bitPadding), ramBitColor);
+				DrawLed(pos + olc::vf2d(ramToBitsPadding + ramBit * bitPadding, ramToBitsPadding + (ramAddress - firstAddress) * bitPadding), ramBitColor);
 			}
 		}
 
+		if (ramContents.size() > 16 && scale > 0.6)
+			DrawLabel(pos + olc::vf2d(ramToBitsPadding, ramHeight - ramToBitsPadding), "@" + std::to_string(firstAddress), olc::DARK_GREY);
+
 		// Draw selected address indicator
 		float addressPadding = ramToBitsPadding;
-		float intraAddressPadding = (addressPadding + (5 * scale)) * selectedRamAddress;
+		float intraAddressPadding = (addressPadding + (5 * scale)) * (selectedRamAddress - firstAddress);
 		float fullPadding = addressPadding + intraAddressPadding;
 		DrawLine(pos + olc::vf2d(0, fullPadding), pos + olc::vf2d(ramWidth, fullPadding), olc::MAGENTA);		
 	}
 
 	void DrawCounter(olc::vi2d pos)
 	{
+		int bits = componentWidth("COUNTER", 4);
 		float scale = pz.GetScale().x;
-		int counterWidth = 120 * scale;
-		int counterHeight = 50 * scale;
 		float bitPadding = 25 * scale;
+		int counterWidth = bitPadding * (bits + 1) - 5 * scale;
+		int counterHeight = 50 * scale;
 
 		DrawRect(pos, { counterWidth, counterHeight }, olc::WHITE);
 
-		std::string counterValueBinary = decimalToBinaryString(counterValue, 4);
+		std::string counterValueBinary = decimalToBinaryString(counterValue, bits);
 
 		olc::Pixel ledColour = olc::VERY_DARK_GREEN;
 
-		if (counterValueBinary[0] == '1')
-			ledColour = olc::GREEN;
-		else
-			ledColour = olc::VERY_DARK_GREEN;
-
-		DrawLed(pos + olc::vf2d(bitPadding - 4, bitPadding), ledColour);
-
-		if (counterValueBinary[1] == '1')
-			ledColour = olc::GREEN;
-		else
-			ledColour = olc::VERY_DARK_GREEN;
-
-		DrawLed(pos + olc::vf2d(bitPadding * 2 - 4, bitPadding), ledColour);
-
-		if (counterValueBinary[2] == '1')
-			ledColour = olc::GREEN;
-		else
-			ledColour = olc::VERY_DARK_GREEN;
-
-		DrawLed(pos + olc::vf2d(bitPadding * 3 - 4, bitPadding), ledColour);
-
-		if (counterValueBinary[3] == '1')
-			ledColour = olc::GREEN;
-		else
-			ledColour = olc::VERY_DARK_GREEN;
+		for (int bit = 0; bit < bits; bit++)
+		{
+			if (counterValueBinary[bit] == '1')
+				ledColour = olc::GREEN;
+			else
+				ledColour = olc::VERY_DARK_GREEN;
 
-		DrawLed(pos + olc::vf2d(bitPadding * 4 - 4, bitPadding), ledColour);
+			DrawLed(pos + olc::vf2d(bitPadding * (bit + 1) - 4, bitPadding), ledColour);
+		}
 	}
 
 	void DrawMicrocounter(olc::vi2d pos)
@@ -1812,7 +6765,7 @@ private:
 			DrawLed(pos + olc::vf2d(bitPadding * bit + xOffset, bitPadding), ledColour);
 
 			if (scale >= 1)
-				DrawString(pos + olc::vf2d(bitPadding * bit + xOffset - (7 * scale), bitPadding + (16 * scale)), controlLabels[bit], olc::WHITE, scale);
+				DrawLabel(pos + olc::vf2d(bitPadding * bit + xOffset - (7 * scale), bitPadding + (16 * scale)), controlLabels[bit], olc::WHITE, scale);
 			else
 				DrawCircle(pos + olc::vf2d(bitPadding * bit + xOffset, bitPadding + (20 * scale)), 2 * scale, olc::WHITE);
 		}
@@ -1850,7 +6803,7 @@ private:
 			DrawLed(pos + olc::vf2d(bitPadding * bit + xOffset, bitPadding), ledColour);
 
 			if (scale >= 1)
-				DrawString(pos + olc::vf2d(bitPadding * bit + xOffset - (7 * scale), bitPadding + (16 * scale)), labels[bit], olc::WHITE, scale);
+				DrawLabel(pos + olc::vf2d(bitPadding * bit + xOffset - (7 * scale), bitPadding + (16 * scale)), labels[bit], olc::WHITE, scale);
 			else
 				DrawCircle(pos + olc::vf2d(bitPadding * bit + xOffset, bitPadding + (20 * scale)), 2 * scale, olc::WHITE);
 		}
@@ -1981,56 +6934,64 @@ private:
 		displayDecimal += displayContents[6] * 2;
 		displayDecimal += displayContents[7] * 1;
 
-		std::string displayDecimalString = std::to_string(displayDecimal);
-		std::string displayChar1 = "0";
-		std::string displayChar2 = "0";
-		std::string displayChar3 = "0";
+		int digits[3] = { displayDecimal / 100, displayDecimal / 10 % 10, displayDecimal % 10 };
+		float interdigitSpacing = 32 * 4 * scale;
 
-		if (displayDecimalString.size() == 3)
-		{
-			displayChar1 = displayDecimalString[0];
-			displayChar2 = displayDecimalString[1];
-			displayChar3 = displayDecimalString[2];
-		}
-		else if (displayDecimalString.size() == 2)
-		{
-			displayChar2 = displayDecimalString[0];
-			displayChar3 = displayDecimalString[1];
-		}
-		else if (displayDecimalString.size() == 1)
-		{
-			displayChar3 = displayDecimalString[0];
-		}
+		for (int digit = 0; digit < 3; digit++)
+			DrawGlyph(*displayGlyphs[digits[digit]], pos + olc::vf2d(digit * interdigitSpacing, 0));
+	}
+
+	// The display's digits drawn once per zoom, each a 4 by 5 grid of LEDs. The engine's draw target is
+	// switched to draw them, so this runs before the tiled renderer's threads start.
+	void prepareDisplayGlyphs()
+	{
+		float scale = pz.GetScale().x;
 
-		std::string combinedPaddedString = displayChar1 + displayChar2 + displayChar3;
+		if (scale == displayGlyphScale)
+			return;
 
-		int digitPixelWidth = 4;
-		int digitPixelHeight = 5;
-		float intradigitSpacing = 30 * scale;
-		float interdigitSpacing = 32 * (digitPixelWidth) * scale;
-		float displayPadding = 30 * scale;
+		float spacing = 30 * scale;
+		float padding = 30 * scale;
+		int ledRadius = 10 * scale;
+		olc::vi2d size = olc::vi2d(int(3 * spacing + padding), int(4 * spacing + padding)) + olc::vi2d(ledRadius + 1, ledRadius + 1);
+		olc::Sprite* screen = GetDrawTarget();
 
-		for (int thisDigitIterator = 0; thisDigitIterator < combinedPaddedString.size(); thisDigitIterator++)
+		for (int digit = 0; digit < 10; digit++)
 		{
-			for (int thisX = 0; thisX < digitPixelWidth; thisX++)
-			{
-				for (int thisY = 0; thisY < digitPixelHeight; thisY++)
-				{
-					char thisDigit = combinedPaddedString[thisDigitIterator];
-					float ledDigitXOffset = (thisDigitIterator * interdigitSpacing);
-					float ledXOffset = thisX * intradigitSpacing + displayPadding;
-					float ledYOffset = thisY * intradigitSpacing + displayPadding;
-					olc::Pixel ledColour = olc::VERY_DARK_RED;
+			displayGlyphs[digit] = std::make_unique<olc::Sprite>(size.x, size.y);
+			SetDrawTarget(displayGlyphs[digit].get());
+			Clear(olc::BLANK);
 
-					if (DecodeDisplayPixel(thisDigit, thisX, thisY))
-						ledColour = olc::RED;
-
-					DrawLed(pos + olc::vf2d(ledDigitXOffset + ledXOffset, ledYOffset), ledColour);
-				}
-			}
+			for (int x = 0; x < 4; x++)
+				for (int y = 0; y < 5; y++)
+					DrawLed(olc::vf2d(x * spacing + padding, y * spacing + padding), DecodeDisplayPixel('0' + digit, x, y) ? olc::RED : olc::VERY_DARK_RED);
 		}
 
-		//DrawString(pos + olc::vf2d{float(width / 7), float(height / 3)}, combinedPaddedString, olc::RED, float(4 * 2.5 * scale));
+		SetDrawTarget(screen);
+		displayGlyphScale = scale;
+	}
+
+	// Copies the opaque pixels of a glyph straight into the draw target, clipped to it and to the tile the
+	// calling thread draws, see Draw.
+	void DrawGlyph(const olc::Sprite& glyph, olc::vi2d pos)
+	{
+		olc::Sprite* target = GetDrawTarget();
+		olc::vi2d low = drawClipLow.max({ 0, 0 });
+		olc::vi2d high = drawClipHigh.min({ target->width, target->height });
+		int left = std::max(0, low.x - pos.x);
+		int top = std::max(0, low.y - pos.y);
+		int right = std::min(glyph.width, high.x - pos.x);
+		int bottom = std::min(glyph.height, high.y - pos.y);
+
+		for (int y = top; y < bottom; y++)
+		{
+			const olc::Pixel* source = &glyph.pColData[y * glyph.width];
+			olc::Pixel* destination = &target->pColData[(pos.y + y) * target->width];
+
+			for (int x = left; x < right; x++)
+				if (source[x].a == 255)
+					destination[pos.x + x] = source[x];
+		}
 	}
 
 	void DrawSource(olc::vi2d pos)
@@ -2059,6 +7020,41 @@ private:
 		DrawString(pos + olc::vi2d(xOffset, 15 * scale), std::to_string(clockSpeed), clockColour);
 	}
 
+	// DrawString without switching the pixel mode, which the tiled renderer's threads share. Labels are
+	// opaque, so the mask mode DrawString switches to draws the same pixels.
+	void DrawLabel(olc::vi2d pos, const std::string& text, olc::Pixel colour, uint32_t scale = 1)
+	{
+		olc::Sprite* font = GetFontSprite();
+		uint32_t size = std::max(scale, 1u);
+
+		// The engine makes the font when the window opens, renders without one go without labels.
+		if (!font)
+			return;
+
+		olc::vi2d cursor = pos;
+
+		for (char c : text)
+		{
+			if (c == '\n')
+			{
+				cursor = { pos.x, cursor.y + 8 * (int)scale };
+				continue;
+			}
+
+			int fontX = (c - 32) % 16 * 8;
+			int fontY = (c - 32) / 16 * 8;
+
+			for (uint32_t i = 0; i < 8; i++)
+				for (uint32_t j = 0; j < 8; j++)
+					if (font->GetPixel(fontX + i, fontY + j).r > 0)
+						for (uint32_t is = 0; is < size; is++)
+							for (uint32_t js = 0; js < size; js++)
+								Draw(cursor.x + i * size + is, cursor.y + j * size + js, colour);
+
+			cursor.x += 8 * scale;
+		}
+	}
+
 	void DrawTerminal(olc::vi2d pos, olc::Pixel colour)
 	{
 		float scale = pz.GetScale().x;
@@ -2102,17 +7098,6 @@ private:
 		return nullptr;
 	}
 
-	Terminal* findTerminal(int id)
-	{
-		for (auto& terminal : terminals)
-		{
-			if (terminal.id == id)
-				return &terminal;
-		}
-
-		return nullptr;
-	}
-
 	Terminal* findTerminalByComponent(int componentId, std::string terminalType)
 	{
 		for (auto& terminal : terminals)
@@ -2215,108 +7200,91 @@ private:
 		}
 	}
 
-	std::string decimalToBinaryString(int decimalInput, int numBits)
+	std::string decimalToBinaryString(long long decimalInput, int numBits)
 	{
-		int cumulativeResult = decimalInput;
-		std::vector<int> powers = { };
-		
-		if (numBits == 8)
-			powers = { 128, 64, 32, 16, 8, 4, 2, 1 };
-		else if (numBits == 4)
-			powers = { 8, 4, 2, 1 };
-		else if (numBits == 3)
-			powers = { 4, 2, 1 };
+		long long maxValue = (1LL << numBits) - 1;
 
-		std::string outputBinary = "";
-		for (auto power : powers)
+		// Out of range values saturate, the same as the old power-of-two subtraction did.
+		if (decimalInput < 0)
+			decimalInput = 0;
+		else if (decimalInput > maxValue)
+			decimalInput = maxValue;
+
+		std::string outputBinary(numBits, '0');
+		for (int bit = 0; bit < numBits; bit++)
 		{
-			if (cumulativeResult >= power)
-			{
-				outputBinary += "1";
-				cumulativeResult -= power;
-			}
-			else
-			{
-				outputBinary += "0";
-			}
+			if ((decimalInput >> (numBits - 1 - bit)) & 1)
+				outputBinary[bit] = '1';
 		}
 
 		return outputBinary;
 	}
 
-	void simulateALU()
+	// Terminals that only exist inside the wire network, everything else is read by a behavioural component or the UI.
+	bool isNetlistInternal(const std::string& type)
 	{
-		int a = 0;
-		int b = 0;
+		return type == "buffer" || type == "transBase" || type == "transCollector" || type == "transEmitter" || type == "transNotOut" || type == "gatedIn" || type == "gatedWriteEnable" || type == "gatedOut" || type == "sourceStart" || type == "sourceEnd" || type == "clock";
+	}
 
-		Terminal* subBit = NULL;
+	// Width of the placed component of this type, or defaultWidth for components placed before widths existed.
+	int componentWidth(std::string componentType, int defaultWidth)
+	{
+		for (auto& component : components)
+		{
+			if (component.type == componentType)
+				return component.width ? component.width : defaultWidth;
+		}
 
-		Terminal* outputBit8 = NULL;
-		Terminal* outputBit7 = NULL;
-		Terminal* outputBit6 = NULL;
-		Terminal* outputBit5 = NULL;
-		Terminal* outputBit4 = NULL;
-		Terminal* outputBit3 = NULL;
-		Terminal* outputBit2 = NULL;
-		Terminal* outputBit1 = NULL;
+		return defaultWidth;
+	}
+
+	// Width to give a component of this type when it is placed, or 0 if the type has a fixed width.
+	int placementWidth(std::string componentType)
+	{
+		auto options = componentWidthOptions.find(componentType);
+
+		if (options == componentWidthOptions.end())
+			return 0;
+
+		return options->second[activeWidthOption % options->second.size()];
+	}
+
+	int aluSize(int bits)
+	{
+		return int(27.3f * (bits + 3));
+	}
+
+	void simulateALU()
+	{
+		int bits = componentWidth("ALU", 8);
+		long long maxValue = (1LL << bits) - 1;
+		long long a = 0;
+		long long b = 0;
 
+		Terminal* subBit = NULL;
 		Terminal* zeroFlagOut = NULL;
 		Terminal* carryFlagOut = NULL;
 
+		// aluInA1, aluInB1 and aluOut1 are the most significant bits.
+		std::vector<Terminal*> outputBits(bits, NULL);
+
 		for (auto& terminal : terminals)
 		{
-			if (terminal.state)
-			{
-				if (terminal.type == "aluInA1")
-					a += 128;
-				else if (terminal.type == "aluInA2")
-					a += 64;
-				else if (terminal.type == "aluInA3")
-					a += 32;
-				else if (terminal.type == "aluInA4")
-					a += 16;
-				else if (terminal.type == "aluInA5")
-					a += 8;
-				else if (terminal.type == "aluInA6")
-					a += 4;
-				else if (terminal.type == "aluInA7")
-					a += 2;
-				else if (terminal.type == "aluInA8")
-					a += 1;
-				else if (terminal.type == "aluInB1")
-					b += 128;
-				else if (terminal.type == "aluInB2")
-					b += 64;
-				else if (terminal.type == "aluInB3")
-					b += 32;
-				else if (terminal.type == "aluInB4")
-					b += 16;
-				else if (terminal.type == "aluInB5")
-					b += 8;
-				else if (terminal.type == "aluInB6")
-					b += 4;
-				else if (terminal.type == "aluInB7")
-					b += 2;
-				else if (terminal.type == "aluInB8")
-					b += 1;
+			if (int bit = terminalBit(terminal.type, "aluInA"))
+			{
+				if (terminal.state && bit <= bits)
+					a |= 1LL << (bits - bit);
+			}
+			else if (int bit = terminalBit(terminal.type, "aluInB"))
+			{
+				if (terminal.state && bit <= bits)
+					b |= 1LL << (bits - bit);
+			}
+			else if (int bit = terminalBit(terminal.type, "aluOut"))
+			{
+				if (bit <= bits)
+					outputBits[bit - 1] = &terminal;
 			}
-			
-			if (terminal.type == "aluOut1")
-				outputBit1 = &terminal;
-			else if (terminal.type == "aluOut2")
-				outputBit2 = &terminal;
-			else if (terminal.type == "aluOut3")
-				outputBit3 = &terminal;
-			else if (terminal.type == "aluOut4")
-				outputBit4 = &terminal;
-			else if (terminal.type == "aluOut5")
-				outputBit5 = &terminal;
-			else if (terminal.type == "aluOut6")
-				outputBit6 = &terminal;
-			else if (terminal.type == "aluOut7")
-				outputBit7 = &terminal;
-			else if (terminal.type == "aluOut8")
-				outputBit8 = &terminal;
 			else if (terminal.type == "aluSub")
 				subBit = &terminal;
 			else if (terminal.type == "aluZeroFlagOut")
@@ -2328,73 +7296,34 @@ private:
 		aluA = a;
 		aluB = b;
 
-		if (subBit && subBit->state)
-			{
-				aluO = a - b;
-			}
-		else 
+		bool subtract = subBit && subBit->state;
+
+		if (subtract)
+			aluO = a - b;
+		else
 			aluO = a + b;
 
 		if (carryFlagOut)
 		{
-			if (aluO > 255)
+			if (aluO > maxValue)
 			{
-				aluO = 255;
+				aluO = maxValue;
 				carryFlagOut->state = true;
 			}
 			else
-			{
-				if (subBit && subBit->state && b == 1 && a != 0)
-					carryFlagOut->state = true;
-				else
-					carryFlagOut->state = false;
-			}
-			
-		}
-
-		bool isNegative = false;
-		int aluOTwosComplement = 0;
-			
-
-		if (aluO < 0)
-		{
-			isNegative = true;
-			aluOTwosComplement = -aluO - 1;
+				carryFlagOut->state = subtract && b == 1 && a != 0;
 		}
-			
 
 		if (zeroFlagOut)
 			zeroFlagOut->state = aluO == 0;
-			
-
-		std::string outputBinary = decimalToBinaryString(aluO, 8);
-
-		if (isNegative)
-			outputBinary = decimalToBinaryString(aluOTwosComplement, 8);
 
+		// Negative results come out in two's complement, overflow saturates.
+		long long outputValue = aluO > maxValue ? maxValue : aluO & maxValue;
 
-		if (outputBit1 && outputBit2 && outputBit3 && outputBit4 && outputBit5 && outputBit6 && outputBit7 && outputBit8)
+		if (std::find(outputBits.begin(), outputBits.end(), nullptr) == outputBits.end())
 		{
-			outputBit1->state = outputBinary[0] == '1';
-			outputBit2->state = outputBinary[1] == '1';
-			outputBit3->state = outputBinary[2] == '1';
-			outputBit4->state = outputBinary[3] == '1';
-			outputBit5->state = outputBinary[4] == '1';
-			outputBit6->state = outputBinary[5] == '1';
-			outputBit7->state = outputBinary[6] == '1';
-			outputBit8->state = outputBinary[7] == '1';
-
-			if (isNegative)
-			{
-				outputBit1->state = !outputBit1->state;
-				outputBit2->state = !outputBit2->state;
-				outputBit3->state = !outputBit3->state;
-				outputBit4->state = !outputBit4->state;
-				outputBit5->state = !outputBit5->state;
-				outputBit6->state = !outputBit6->state;
-				outputBit7->state = !outputBit7->state;
-				outputBit8->state = !outputBit8->state;
-			}
+			for (int bit = 0; bit < bits; bit++)
+				outputBits[bit]->state = (outputValue >> (bits - 1 - bit)) & 1;
 		}
 	}
 
@@ -2639,10 +7568,9 @@ private:
 
 		Terminal* writeEnableTerminal = NULL;
 
-		Terminal* addressTerminal1 = NULL;
-		Terminal* addressTerminal2 = NULL;
-		Terminal* addressTerminal3 = NULL;
-		Terminal* addressTerminal4 = NULL;
+		// ramAddressIn1 is the least significant address bit.
+		int addressBits = componentWidth("RAM", 4);
+		std::vector<Terminal*> addressTerminals(addressBits, NULL);
 
 		for (auto& terminal : terminals)
 		{
@@ -2680,32 +7608,23 @@ private:
 				inputBit7 = &terminal;
 			else if (terminal.type == "ramIn8")
 				inputBit8 = &terminal;
-			else if (terminal.type == "ramAddressIn1")
-				addressTerminal1 = &terminal;
-			else if (terminal.type == "ramAddressIn2")
-				addressTerminal2 = &terminal;
-			else if (terminal.type == "ramAddressIn3")
-				addressTerminal3 = &terminal;
-			else if (terminal.type == "ramAddressIn4")
-				addressTerminal4 = &terminal;
+			else if (int bit = terminalBit(terminal.type, "ramAddressIn"))
+			{
+				if (bit <= addressBits)
+					addressTerminals[bit - 1] = &terminal;
+			}
 		}
 
-		if (addressTerminal1 && addressTerminal2 && addressTerminal3 && addressTerminal4)
+		if (std::find(addressTerminals.begin(), addressTerminals.end(), nullptr) == addressTerminals.end())
 		{
 			int ramAddressSum = 0;
-			if (addressTerminal1->state)
-				ramAddressSum += 1;
-
-			if (addressTerminal2->state)
-				ramAddressSum += 2;
-
-			if (addressTerminal3->state)
-				ramAddressSum += 4;
-
-			if (addressTerminal4->state)
-				ramAddressSum += 8;
+			for (int bit = 0; bit < addressBits; bit++)
+			{
+				if (addressTerminals[bit]->state)
+					ramAddressSum |= 1 << bit;
+			}
 
-			if (ramAddressSum > 15)
+			if (ramAddressSum >= (int)ramContents.size())
 				ramAddressSum = 0;
 
 			selectedRamAddress = ramAddressSum;
@@ -2717,54 +7636,39 @@ private:
 			{
 				if (!ramFixMode || (selectedRamAddress > 0 && (inputBit1->state || inputBit2->state || inputBit3->state || inputBit4->state || inputBit5->state || inputBit6->state || inputBit7->state || inputBit8->state)))
 				{
-					ramContents[selectedRamAddress][0] = inputBit1->state;
-					ramContents[selectedRamAddress][1] = inputBit2->state;
-					ramContents[selectedRamAddress][2] = inputBit3->state;
-					ramContents[selectedRamAddress][3] = inputBit4->state;
-					ramContents[selectedRamAddress][4] = inputBit5->state;
-					ramContents[selectedRamAddress][5] = inputBit6->state;
-					ramContents[selectedRamAddress][6] = inputBit7->state;
-					ramContents[selectedRamAddress][7] = inputBit8->state;
+					uint8_t inputWord = 0;
+					inputWord |= inputBit1->state << 7;
+					inputWord |= inputBit2->state << 6;
+					inputWord |= inputBit3->state << 5;
+					inputWord |= inputBit4->state << 4;
+					inputWord |= inputBit5->state << 3;
+					inputWord |= inputBit6->state << 2;
+					inputWord |= inputBit7->state << 1;
+					inputWord |= inputBit8->state;
+
+					ramContents.write(selectedRamAddress, inputWord);
 				}
 			}
 		}
 
-		if (outputBit8)
-			outputBit8->state = ramContents[selectedRamAddress][7];
-
-		if (outputBit7)
-			outputBit7->state = ramContents[selectedRamAddress][6];
-
-		if (outputBit6)
-			outputBit6->state = ramContents[selectedRamAddress][5];
-
-		if (outputBit5)
-			outputBit5->state = ramContents[selectedRamAddress][4];
-
-		if (outputBit4)
-			outputBit4->state = ramContents[selectedRamAddress][3];
-
-		if (outputBit3)
-			outputBit3->state = ramContents[selectedRamAddress][2];
-
-		if (outputBit2)
-			outputBit2->state = ramContents[selectedRamAddress][1];
+		uint8_t word = ramContents.read(selectedRamAddress);
+		std::vector<Terminal*> outputBits = { outputBit1, outputBit2, outputBit3, outputBit4, outputBit5, outputBit6, outputBit7, outputBit8 };
 
-		if (outputBit1)
-			outputBit1->state = ramContents[selectedRamAddress][0];
+		for (int bit = 0; bit < 8; bit++)
+		{
+			if (outputBits[bit])
+				outputBits[bit]->state = (word >> (7 - bit)) & 1;
+		}
 	}
 
 	void simulateCounter()
 	{
-		Terminal* inputBit4 = NULL;
-		Terminal* inputBit3 = NULL;
-		Terminal* inputBit2 = NULL;
-		Terminal* inputBit1 = NULL;
+		int bits = componentWidth("COUNTER", 4);
+		int maxValue = int((1LL << bits) - 1);
 
-		Terminal* outputBit4 = NULL;
-		Terminal* outputBit3 = NULL;
-		Terminal* outputBit2 = NULL;
-		Terminal* outputBit1 = NULL;
+		// counterIn1 and counterOut1 are the least significant bits.
+		std::vector<Terminal*> inputBits(bits, NULL);
+		std::vector<Terminal*> outputBits(bits, NULL);
 
 		Terminal* writeEnableTerminal = NULL;
 		Terminal* clockTerminal = NULL;
@@ -2778,91 +7682,43 @@ private:
 				clockTerminal = &terminal;
 			else if (terminal.type == "counterCountEnable")
 				countEnableTerminal = &terminal;
-			else if (terminal.type == "counterOut1")
-				outputBit1 = &terminal;
-			else if (terminal.type == "counterOut2")
-				outputBit2 = &terminal;
-			else if (terminal.type == "counterOut3")
-				outputBit3 = &terminal;
-			else if (terminal.type == "counterOut4")
-				outputBit4 = &terminal;
-			else if (terminal.type == "counterIn1")
-				inputBit1 = &terminal;
-			else if (terminal.type == "counterIn2")
-				inputBit2 = &terminal;
-			else if (terminal.type == "counterIn3")
-				inputBit3 = &terminal;
-			else if (terminal.type == "counterIn4")
-				inputBit4 = &terminal;
+			else if (int bit = terminalBit(terminal.type, "counterOut"))
+			{
+				if (bit <= bits)
+					outputBits[bit - 1] = &terminal;
+			}
+			else if (int bit = terminalBit(terminal.type, "counterIn"))
+			{
+				if (bit <= bits)
+					inputBits[bit - 1] = &terminal;
+			}
 		}
 
 		if (writeEnableTerminal && writeEnableTerminal->state)
 		{
-			if (inputBit1 && inputBit2 && inputBit3 && inputBit4)
+			if (std::find(inputBits.begin(), inputBits.end(), nullptr) == inputBits.end())
 			{
 				counterValue = 0;
-				if (inputBit1->state)
-					counterValue += 1;
-				
-				if (inputBit2->state)
-					counterValue += 2;
-
-				if (inputBit3->state)
-					counterValue += 4;
-
-				if (inputBit4->state)
-					counterValue += 8;
+				for (int bit = 0; bit < bits; bit++)
+				{
+					if (inputBits[bit]->state)
+						counterValue |= 1 << bit;
+				}
 			}
 		}
 		else
 		{
 			if (!counterCounted && risingEdge && countEnableTerminal && countEnableTerminal->state)
 			{
-				if (counterValue < 15)
-					counterValue++;
-				else
-					counterValue = 0;
-
+				counterValue = (counterValue + 1) & maxValue;
 				counterCounted = true;
 			}
 		}
 
-		std::string outputBinary = decimalToBinaryString(counterValue, 4);
-
-		if (outputBit1)
-		{
-			if (outputBinary[3] == '1')
-			{
-				outputBit1->state = true;
-			}
-			else
-			{
-				outputBit1->state = false;
-			}
-		}
-		
-		if (outputBit2)
-		{
-			if (outputBinary[2] == '1')
-				outputBit2->state = true;
-			else
-				outputBit2->state = false;
-		}
-
-		if (outputBit3)
-		{
-			if (outputBinary[1] == '1')
-				outputBit3->state = true;
-			else
-				outputBit3->state = false;
-		}
-		
-		if (outputBit4)
+		for (int bit = 0; bit < bits; bit++)
 		{
-			if (outputBinary[0] == '1')
-				outputBit4->state = true;
-			else
-				outputBit4->state = false;
+			if (outputBits[bit])
+				outputBits[bit]->state = (counterValue >> bit) & 1;
 		}
 	}
 
@@ -3402,68 +8258,9 @@ private:
 	}
 
 	void updateSourceConnections()
-	{
-		sourceConnections.clear();
-
-		for (auto& connection : connections)
-		{
-			if (connection.terminalA == 1 || connection.terminalA == 3)
-				sourceConnections.push_back(&connection);
-			else
-			{
-				Terminal* thisTerminalA = findTerminal(connection.terminalA);
-				if (thisTerminalA)
-				{
-					if (thisTerminalA->type == "gatedOut")
-						sourceConnections.push_back(&connection);
-
-					if (("aluOut1" <= thisTerminalA->type && thisTerminalA->type <= "aluOut8"))
-					{
-						sourceConnections.push_back(&connection);
-					}
-
-					if (("ramOut1" <= thisTerminalA->type && thisTerminalA->type <= "ramOut8"))
-					{
-						sourceConnections.push_back(&connection);
-					}
-
-					if (("counterOut1" <= thisTerminalA->type && thisTerminalA->type <= "counterOut4"))
-					{
-						sourceConnections.push_back(&connection);
-					}
-
-					if (("microcounterOut1" <= thisTerminalA->type && thisTerminalA->type <= "microcounterOut3"))
-					{
-						sourceConnections.push_back(&connection);
-					}
-
-					if (("IROut1" <= thisTerminalA->type && thisTerminalA->type <= "IROut4"))
-					{
-						sourceConnections.push_back(&connection);
-					}
-
-					if (thisTerminalA->type.find("decoderOut") != std::string::npos)
-					{
-						sourceConnections.push_back(&connection);
-					}
-
-					if (("flagsRegOut1" <= thisTerminalA->type && thisTerminalA->type <= "flagsRegOut2"))
-					{
-						sourceConnections.push_back(&connection);
-					}
-
-					if (thisTerminalA->type == "aluZeroFlagOut" || thisTerminalA->type == "aluCarryFlagOut")
-					{
-						sourceConnections.push_back(&connection);
-					}
-
-					if (("IRDecodeOut5" <= thisTerminalA->type && thisTerminalA->type <= "IRDecodeOut8"))
-					{
-						sourceConnections.push_back(&connection);
-					}
-				}
-			}
-		}
+	{
+		Profiler::Timer timer(profiler, Profiler::SOURCES);
+		Design::updateSourceConnections();
 	}
 
 	olc::vf2d GetWorldMouse()
@@ -3501,6 +8298,7 @@ private:
 			{
 				if (iter->id == closestConnectionNotOutTerminalId)
 				{
+					journalRemoved("T", iter - terminals.begin());
 					iter = terminals.erase(iter);
 					break;
 				}
@@ -3511,6 +8309,7 @@ private:
 			{
 				if (iter->id == closestConnectionId)
 				{
+					journalRemoved("W", iter - connections.begin());
 					iter = connections.erase(iter);
 					break;
 				}
@@ -3580,12 +8379,14 @@ private:
 											{
 												if (notOutTerminalIter->id == connIter->notOutTerminal)
 												{
+													journalRemoved("T", notOutTerminalIter - terminals.begin());
 													notOutTerminalIter = terminals.erase(notOutTerminalIter);
 													break;
 												}
 											}
 										}
 
+										journalRemoved("W", connIter - connections.begin());
 										connIter = connections.erase(connIter);
 										break;
 									}
@@ -3593,6 +8394,7 @@ private:
 							}
 
 
+							journalRemoved("T", iter - terminals.begin());
 							iter = terminals.erase(iter);
 							break;
 						}
@@ -3604,6 +8406,7 @@ private:
 				{
 					if (iter->id == closestId)
 					{
+						journalRemoved("C", iter - components.begin());
 						iter = components.erase(iter);
 						break;
 					}
@@ -3611,10 +8414,31 @@ private:
 			}
 		}
 
+		flushJournal();
+		spatialGrid.valid = false;
 		updateSourceConnections();
 		updateSimulation = true;
 	}
 
+	int ramWindowStart()
+	{
+		return (selectedRamAddress / 16) * 16;
+	}
+
+	int ramWindowRows()
+	{
+		return std::min(16, (int)ramContents.size() - ramWindowStart());
+	}
+
+	// Grows or shrinks the RAM to 2^addressBits bytes, keeping the existing contents.
+	void configureRAM(int addressBits)
+	{
+		ramContents.resize(size_t(1) << addressBits);
+
+		if (selectedRamAddress >= (int)ramContents.size())
+			selectedRamAddress = 0;
+	}
+
 	void programRAM()
 	{
 		double smallestDistance = 0.00;
@@ -3631,11 +8455,13 @@ private:
 				ramWorldPos = component.pos;
 		}
 
-		for (int ramAddress = 0; ramAddress < ramContents.size(); ramAddress++)
+		int firstAddress = ramWindowStart();
+
+		for (int ramAddress = firstAddress; ramAddress < firstAddress + ramWindowRows(); ramAddress++)
 		{
-			for (int ramBit = 0; ramBit < ramContents[0].size(); ramBit++)
+			for (int ramBit = 0; ramBit < 8; ramBit++)
 			{
-				olc::vf2d thisBitPosition = { ramToBitsPadding + ramBit * bitPadding, ramToBitsPadding + ramAddress * bitPadding };
+				olc::vf2d thisBitPosition = { ramToBitsPadding + ramBit * bitPadding, ramToBitsPadding + (ramAddress - firstAddress) * bitPadding };
 				double distance = CalculateDistance(ramWorldPos + thisBitPosition, GetWorldMouse());
 
 				if (distance < smallestDistance || smallestDistance == 0.00)
@@ -3650,10 +8476,30 @@ private:
 
 		if (smallestDistance < 10.00)
 		{
-			ramContents[closestRamAddress][closestRamBit] = !ramContents[closestRamAddress][closestRamBit];
+			ramContents.toggleBit(closestRamAddress, closestRamBit);
 		}
 	}
 
+	// Clock speed 1 toggles the clock and runs a simulation pass as often as fits in most of a frame at targetFps,
+	// where it used to do it once per frame. The redraw after them gets the rest of the frame.
+	void freeRunClock()
+	{
+		auto start = std::chrono::steady_clock::now();
+		auto deadline = start + std::chrono::microseconds(800000 / targetFps);
+		auto now = start;
+		auto passTime = now - start;
+
+		do
+		{
+			simulateClock();
+			runSimulation();
+
+			auto passEnd = std::chrono::steady_clock::now();
+			passTime = passEnd - now;
+			now = passEnd;
+		} while (clockSpeed == 1 && now + passTime < deadline);
+	}
+
 	void simulateClock()
 	{
 		Terminal* clockHaltTerminal = NULL;
@@ -3711,7 +8557,10 @@ private:
 		bool oldFallingEdge = fallingEdge;
 
 		if (!oldState && newState)
+		{
 			risingEdge = true;
+			clockCycles++;
+		}
 		else
 			risingEdge = false;
 
@@ -3724,8 +8573,588 @@ private:
 			redrawRequired = true;
 	}
 
-	std::vector<std::vector<int>> loadProgram(std::string programName)
+	Netlist buildNetlist()
+	{
+		return buildNetlist(terminals, connections, components, true);
+	}
+
+	// Terminals 1 and 3 are only the supply and clock at the top level, inside a module definition they are ordinary.
+	Netlist buildNetlist(const std::vector<Terminal>& netlistTerminals, const std::vector<Connection>& netlistConnections, const std::vector<Component>& netlistComponents, bool topLevel)
+	{
+		Netlist netlist;
+		std::map<int, int> terminalIndices;
+		std::map<std::string, int> busNodes;
+		std::map<int, std::vector<int>> componentTerminals;
+
+		for (int i = 0; i < (int)netlistTerminals.size(); i++)
+		{
+			const Terminal& terminal = netlistTerminals[i];
+			componentTerminals[terminal.componentId].push_back(i);
+
+			// Saves can repeat a terminal id, findTerminal resolves it to the first one.
+			if (!terminalIndices.count(terminal.id))
+				terminalIndices[terminal.id] = i;
+
+			// Every terminal of a bus line is the same net.
+			if ("bus1" <= terminal.type && terminal.type <= "bus8")
+			{
+				if (busNodes.count(terminal.type))
+				{
+					netlist.terminalNodes.push_back(busNodes[terminal.type]);
+					continue;
+				}
+
+				busNodes[terminal.type] = (int)netlist.nodes.size();
+			}
+
+			Netlist::Node node;
+
+			if (topLevel && terminal.id == 1)
+				node.kind = Netlist::NODE_CONSTANT;
+			else if ((topLevel && terminal.id == 3) || terminal.type == "sourceStart" || isBehaviouralOutput(terminal.type))
+				node.kind = Netlist::NODE_EXTERNAL;
+			else if (terminal.type == "gatedOut")
+				node.kind = Netlist::NODE_LATCH;
+			else if (terminal.type == "transEmitter")
+				node.kind = Netlist::NODE_EMITTER;
+			else if (terminal.type == "transNotOut")
+				node.kind = Netlist::NODE_NOT_OUT;
+
+			netlist.terminalNodes.push_back((int)netlist.nodes.size());
+			netlist.nodes.push_back(node);
+		}
+
+		// LEDs are outputs too, even though only the UI looks at them.
+		std::vector<int> ledComponentIds;
+		for (auto& component : netlistComponents)
+			if (component.type == "LED")
+				ledComponentIds.push_back(component.id);
+
+		netlist.hostNodes.assign(netlist.nodes.size(), false);
+		for (int i = 0; i < (int)netlistTerminals.size(); i++)
+			if (!isNetlistInternal(netlistTerminals[i].type) || std::find(ledComponentIds.begin(), ledComponentIds.end(), netlistTerminals[i].componentId) != ledComponentIds.end())
+				netlist.hostNodes[netlist.terminalNodes[i]] = true;
+
+		// Hook transistor and latch outputs up to the other terminals of their component.
+		for (auto& component : componentTerminals)
+		{
+			if (!component.first)
+				continue;
+
+			int base = -1, collector = -1, dataIn = -1, writeEnable = -1;
+
+			for (int i : component.second)
+			{
+				if (netlistTerminals[i].type == "transBase")
+					base = netlist.terminalNodes[i];
+				else if (netlistTerminals[i].type == "transCollector")
+					collector = netlist.terminalNodes[i];
+				else if (netlistTerminals[i].type == "gatedIn")
+					dataIn = netlist.terminalNodes[i];
+				else if (netlistTerminals[i].type == "gatedWriteEnable")
+					writeEnable = netlist.terminalNodes[i];
+			}
+
+			for (int i : component.second)
+			{
+				Netlist::Node& node = netlist.nodes[netlist.terminalNodes[i]];
+
+				if (node.kind == Netlist::NODE_EMITTER || node.kind == Netlist::NODE_NOT_OUT)
+				{
+					node.inputA = base;
+					node.inputB = collector;
+				}
+				else if (node.kind == Netlist::NODE_LATCH)
+				{
+					node.inputA = dataIn;
+					node.inputB = writeEnable;
+				}
+			}
+		}
+
+		// Only terminals the interpreter propagates from drive their connections.
+		for (auto& connection : netlistConnections)
+		{
+			if (!terminalIndices.count(connection.terminalA) || !terminalIndices.count(connection.terminalB))
+				continue;
+
+			const Terminal& terminalA = netlistTerminals[terminalIndices[connection.terminalA]];
+			int nodeA = netlist.terminalNodes[terminalIndices[connection.terminalA]];
+			int nodeB = netlist.terminalNodes[terminalIndices[connection.terminalB]];
+
+			bool propagates = (topLevel && (terminalA.id == 1 || terminalA.id == 3)) || terminalA.type == "gatedOut" || isBehaviouralOutput(terminalA.type) || terminalA.type == "buffer" || terminalA.type == "transEmitter" || terminalA.type == "transNotOut" || ("bus1" <= terminalA.type && terminalA.type <= "bus8");
+			std::vector<int>& fanIn = netlist.nodes[nodeB].fanIn;
+
+			if (propagates && nodeA != nodeB && Netlist::isCombinational(netlist.nodes[nodeB].kind) && std::find(fanIn.begin(), fanIn.end(), nodeA) == fanIn.end())
+				fanIn.push_back(nodeA);
+		}
+
+		return netlist;
+	}
+
+	// One pass of the compiled wire network followed by the behavioural components, mirroring runSimulation.
+	void runCompiledSimulation()
+	{
+		if (!updateSimulation || simulationPaused)
+			return;
+
+		Profiler::Timer timer(profiler, Profiler::SETTLE);
+
+		redrawRequired = true;
+
+		std::vector<int> previousTerminalsState;
+		std::vector<uint8_t>& values = compiledNetlist.values;
+
+		for (int i = 0; i < (int)terminals.size(); i++)
+		{
+			int node = netlist.terminalNodes[i];
+			Netlist::NodeKind kind = netlist.nodes[node].kind;
+
+			previousTerminalsState.push_back(terminals[i].state);
+
+			if (kind == Netlist::NODE_CONSTANT)
+				values[node] = netlist.nodes[node].value;
+			else if (terminals[i].id == 3)
+				values[node] = clockState;
+			else if (kind == Netlist::NODE_EXTERNAL || kind == Netlist::NODE_LATCH)
+				values[node] = terminals[i].state;
+		}
+
+		if (risingEdge)
+			compiledNetlist.risingEdge(values.data());
+		else if (fallingEdge)
+			compiledNetlist.fallingEdge(values.data());
+		else
+			compiledNetlist.settle(values.data());
+
+		// Folded terminals still show their constant state, terminal 1 keeps its saved one like in the interpreter.
+		for (int i = 0; i < (int)terminals.size(); i++)
+			if (terminals[i].id != 1)
+				terminals[i].state = values[netlist.terminalNodes[i]];
+
+		counterCounted = false;
+		microcounterCounted = false;
+
+		{
+			Profiler::Timer timer(profiler, Profiler::BEHAVIOURAL);
+			simulateALU();
+			simulateCounter();
+			simulateMicrocounter();
+			simulateIR();
+			simulateDecoder();
+			simulateFlagsReg();
+			simulateDisplay();
+			simulateRAM();
+			simulateModules();
+		}
+
+		countToggles(previousTerminalsState);
+
+		bool somethingChanged = false;
+		for (int i = 0; i < (int)terminals.size(); i++)
+		{
+			if (previousTerminalsState[i] != terminals[i].state)
+			{
+				somethingChanged = true;
+				break;
+			}
+		}
+
+		if (!somethingChanged)
+			updateSimulation = false;
+	}
+
+	// Adds up which terminals a pass switched. Wires and components are worked out from these when needed.
+	void countToggles(const std::vector<int>& previousTerminalsState)
+	{
+		if (terminalToggles.size() != terminals.size())
+			resetToggles();
+
+		for (size_t i = 0; i < terminals.size(); i++)
+			terminalToggles[i] += previousTerminalsState[i] != (int)terminals[i].state;
+	}
+
+	void resetToggles()
+	{
+		terminalToggles.assign(terminals.size(), 0);
+		activityStartCycles = clockCycles;
+	}
+
+	// A wire carries the state of the terminal it starts from, a component counts all of its terminals.
+	void refreshActivity()
+	{
+		if (terminalToggles.size() != terminals.size())
+			resetToggles();
+
+		std::unordered_map<int, int> terminalIndices;
+		std::unordered_map<int, int> componentIndices;
+
+		for (int i = 0; i < (int)terminals.size(); i++)
+			terminalIndices[terminals[i].id] = i;
+
+		for (int i = 0; i < (int)components.size(); i++)
+			componentIndices[components[i].id] = i;
+
+		connectionToggles.assign(connections.size(), 0);
+		componentToggles.assign(components.size(), 0);
+
+		for (size_t i = 0; i < connections.size(); i++)
+		{
+			auto terminal = terminalIndices.find(connections[i].terminalA);
+			if (terminal != terminalIndices.end())
+				connectionToggles[i] = terminalToggles[terminal->second];
+		}
+
+		for (size_t i = 0; i < terminals.size(); i++)
+		{
+			auto component = componentIndices.find(terminals[i].componentId);
+			if (component != componentIndices.end())
+				componentToggles[component->second] += terminalToggles[i];
+		}
+
+		mostConnectionToggles = connectionToggles.empty() ? 0 : *std::max_element(connectionToggles.begin(), connectionToggles.end());
+		mostComponentToggles = componentToggles.empty() ? 0 : *std::max_element(componentToggles.begin(), componentToggles.end());
+	}
+
+	// The toggle counts of every terminal, wire and component as CSV, busiest first within each kind.
+	bool ExportActivity(std::string path)
+	{
+		refreshActivity();
+
+		std::ofstream csv(path);
+		if (!csv)
+		{
+			std::cout << "Could not write " << path << std::endl;
+			return false;
+		}
+
+		long long cycles = std::max(1LL, clockCycles - activityStartCycles);
+		csv << "kind,id,type,toggles,toggles per cycle" << std::endl;
+
+		auto write = [&](std::string kind, const std::vector<uint32_t>& toggles, auto id, auto type)
+		{
+			std::vector<int> order(toggles.size());
+			for (int i = 0; i < (int)order.size(); i++)
+				order[i] = i;
+
+			std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return toggles[a] > toggles[b]; });
+
+			for (int i : order)
+				csv << kind << "," << id(i) << "," << type(i) << "," << toggles[i] << "," << toggles[i] / (double)cycles << std::endl;
+		};
+
+		write("terminal", terminalToggles, [&](int i) { return terminals[i].id; }, [&](int i) { return terminals[i].type; });
+		write("connection", connectionToggles, [&](int i) { return connections[i].id; }, [&](int) { return std::string("wire"); });
+		write("component", componentToggles, [&](int i) { return components[i].id; }, [&](int i) { return components[i].type; });
+
+		std::cout << "Wrote the activity of the last " << clockCycles - activityStartCycles << " cycles to " << path << std::endl;
+		return true;
+	}
+
+	// The profiler's history as one row per sample, oldest first.
+	bool ExportProfile(std::string path)
+	{
+		std::ofstream csv(path);
+		if (!csv)
+		{
+			std::cout << "Could not write " << path << std::endl;
+			return false;
+		}
+
+		csv << "series,unit,sample,value" << std::endl;
+
+		for (int series = 0; series < Profiler::SERIES_COUNT; series++)
+		{
+			std::vector<double> values = profiler.ordered(series);
+
+			for (size_t i = 0; i < values.size(); i++)
+				csv << Profiler::names[series] << "," << (series < Profiler::timedSeries ? "ms per frame" : "per settle") << "," << i << "," << values[i] << std::endl;
+		}
+
+		std::cout << "Wrote the profile to " << path << std::endl;
+		return true;
+	}
+
+	// Average time of one compiled settle pass over the current node values, in nanoseconds.
+	double timeSettle(CompiledNetlist& compiled)
+	{
+		const int passes = 20000;
+		std::vector<uint8_t> values = compiledNetlist.values;
+
+		auto start = std::chrono::steady_clock::now();
+		for (int pass = 0; pass < passes; pass++)
+			compiled.settle(values.data());
+
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / passes;
+	}
+
+	// Uses the compiled netlist when one matches the current circuit, otherwise the interpreter.
+	void simulatePass()
+	{
+		if (compiledNetlist.ready() && netlist.terminalNodes.size() == terminals.size())
+			runCompiledSimulation();
+		else
+			runSimulation();
+	}
+
+	// Toggle the clock once and let the gate level machine settle without waiting for frames.
+	bool stepClock()
+	{
+		for (auto& terminal : terminals)
+			if (terminal.type == "clockHalt" && terminal.state)
+				return false;
+
+		clockState = !clockState;
+		risingEdge = clockState;
+		fallingEdge = !clockState;
+
+		if (risingEdge)
+			clockCycles++;
+
+		updateSimulation = true;
+		simulatePass();
+
+		risingEdge = false;
+		fallingEdge = false;
+
+		for (int pass = 0; updateSimulation && pass < 100; pass++)
+			simulatePass();
+
+		return true;
+	}
+
+	// Clock the machine until the microcounter is back at 000 with the clock low.
+	bool stepToInstructionBoundary()
+	{
+		if (clockState && !stepClock())
+			return false;
+
+		for (int cycle = 0; cycle < 16; cycle++)
+		{
+			if (!stepClock() || !stepClock())
+				return false;
+
+			if (microcounterValue == 0)
+				return true;
+		}
+
+		return false;
+	}
+
+	// Follows connections back through buffers to the latch that drives a register input.
+	Terminal* findDrivingLatch(Terminal* input)
+	{
+		std::vector<int> frontier = { input->id };
+		std::vector<int> visitedTerminalIds;
+
+		while (frontier.size())
+		{
+			int terminalId = frontier.back();
+			frontier.pop_back();
+
+			for (auto& connection : connections)
+			{
+				if (connection.terminalB != terminalId || std::find(visitedTerminalIds.begin(), visitedTerminalIds.end(), connection.terminalA) != visitedTerminalIds.end())
+					continue;
+
+				visitedTerminalIds.push_back(connection.terminalA);
+				Terminal* source = findTerminal(connection.terminalA);
+
+				if (source && source->type == "gatedOut")
+					return source;
+
+				if (source && source->type == "buffer")
+					frontier.push_back(source->id);
+			}
+		}
+
+		return nullptr;
+	}
+
+	// Latches for each bit of a register, index 0 is the terminal ending in 1.
+	std::vector<Terminal*> findRegisterLatches(std::string inputPrefix, int bits)
+	{
+		std::vector<Terminal*> latches(bits, nullptr);
+
+		for (auto& terminal : terminals)
+		{
+			int bit = terminalBit(terminal.type, inputPrefix.c_str());
+
+			if (bit && bit <= bits && !latches[bit - 1])
+				latches[bit - 1] = findDrivingLatch(&terminal);
+		}
+
+		return latches;
+	}
+
+	int latchValue(const std::vector<Terminal*>& latches, bool msbFirst)
+	{
+		int value = 0;
+
+		for (int i = 0; i < (int)latches.size(); i++)
+			if (latches[i] && latches[i]->state)
+				value |= 1 << (msbFirst ? (int)latches.size() - 1 - i : i);
+
+		return value;
+	}
+
+	void setLatchValue(std::vector<Terminal*>& latches, bool msbFirst, int value)
+	{
+		for (int i = 0; i < (int)latches.size(); i++)
+			if (latches[i])
+				latches[i]->state = (value >> (msbFirst ? (int)latches.size() - 1 - i : i)) & 1;
+	}
+
+	int busValue()
+	{
+		int value = 0;
+
+		for (auto& terminal : terminals)
+			if ("bus1" <= terminal.type && terminal.type <= "bus8" && terminal.state)
+				value |= 1 << (terminal.type[3] - '1');
+
+		return value;
+	}
+
+	int registerContents(const std::vector<int>& contents, bool msbFirst)
+	{
+		int value = 0;
+
+		for (int i = 0; i < (int)contents.size(); i++)
+			if (contents[i])
+				value |= 1 << (msbFirst ? (int)contents.size() - 1 - i : i);
+
+		return value;
+	}
+
+	void setRegisterContents(std::vector<int>& contents, bool msbFirst, int value)
+	{
+		for (int i = 0; i < (int)contents.size(); i++)
+			contents[i] = (value >> (msbFirst ? (int)contents.size() - 1 - i : i)) & 1;
+	}
+
+	void syncEmulatorFromMachine()
+	{
+		std::vector<Terminal*> aLatches = findRegisterLatches("aluInA", 8);
+		std::vector<Terminal*> bLatches = findRegisterLatches("aluInB", 8);
+		std::vector<Terminal*> marLatches = findRegisterLatches("ramAddressIn", componentWidth("RAM", 4));
+
+		emulator.ram = &ramContents;
+		emulator.ramFixMode = ramFixMode;
+		emulator.pcMask = (1 << componentWidth("COUNTER", 4)) - 1;
+		emulator.marMask = (int)ramContents.size() - 1;
+		emulator.a = uint8_t(latchValue(aLatches, true));
+		emulator.b = uint8_t(latchValue(bLatches, true));
+		emulator.mar = latchValue(marLatches, false);
+		emulator.pc = counterValue;
+		emulator.ir = uint8_t(registerContents(IRContents, false));
+		emulator.carry = flagsRegContents[0];
+		emulator.zero = flagsRegContents[1];
+		emulator.display = uint8_t(registerContents(displayContents, true));
+		emulator.halted = false;
+		emulator.cycles = clockCycles;
+	}
+
+	void syncMachineFromEmulator()
+	{
+		std::vector<Terminal*> aLatches = findRegisterLatches("aluInA", 8);
+		std::vector<Terminal*> bLatches = findRegisterLatches("aluInB", 8);
+		std::vector<Terminal*> marLatches = findRegisterLatches("ramAddressIn", componentWidth("RAM", 4));
+
+		setLatchValue(aLatches, true, emulator.a);
+		setLatchValue(bLatches, true, emulator.b);
+		setLatchValue(marLatches, false, emulator.mar);
+		counterValue = emulator.pc;
+		setRegisterContents(IRContents, false, emulator.ir);
+		flagsRegContents[0] = emulator.carry;
+		flagsRegContents[1] = emulator.zero;
+		setRegisterContents(displayContents, true, emulator.display);
+		clockCycles = emulator.cycles;
+
+		// A halted program is left on the HT step so the clock stays stopped.
+		microcounterValue = emulator.halted ? 2 : 0;
+		clockState = false;
+		risingEdge = false;
+		fallingEdge = false;
+
+		updateSimulation = true;
+		for (int pass = 0; updateSimulation && pass < 100; pass++)
+			simulatePass();
+
+		redrawRequired = true;
+	}
+
+	// Skip ahead with the instruction emulator, then load its state back into the gate level machine.
+	void fastForward(long long cycles)
+	{
+		if (!stepToInstructionBoundary())
+			return;
+
+		syncEmulatorFromMachine();
+		emulator.run(clockCycles + cycles);
+		syncMachineFromEmulator();
+
+		emulatorStatus = "FAST FORWARD TO CYCLE " + std::to_string(clockCycles);
+	}
+
+	// Returns a description of the first register that differs from the emulator, or an empty string.
+	std::string compareWithEmulator()
+	{
+		std::vector<std::pair<std::string, std::pair<long long, long long>>> checks = {
+			{ "CYCLES", { clockCycles, emulator.cycles } },
+			{ "A", { latchValue(findRegisterLatches("aluInA", 8), true), emulator.a } },
+			{ "B", { latchValue(findRegisterLatches("aluInB", 8), true), emulator.b } },
+			{ "PC", { counterValue, emulator.pc } },
+			{ "IR", { registerContents(IRContents, false), emulator.ir } },
+			{ "CF", { flagsRegContents[0], emulator.carry } },
+			{ "ZF", { flagsRegContents[1], emulator.zero } },
+			{ "OUT", { registerContents(displayContents, true), emulator.display } },
+		};
+
+		// Step 000 puts the program counter on the bus.
+		if (!emulator.halted)
+			checks.push_back({ "BUS", { busValue(), emulator.pc } });
+
+		for (auto& check : checks)
+			if (check.second.first != check.second.second)
+				return check.first + " " + std::to_string(check.second.first) + " != " + std::to_string(check.second.second);
+
+		return "";
+	}
+
+	// Run one instruction on both models and pause on the first divergence.
+	void lockstepInstruction()
+	{
+		if (emulator.halted)
+			return;
+
+		emulator.step();
+
+		if (!stepToInstructionBoundary() && !emulator.halted)
+			emulatorStatus = "LOCKSTEP: MACHINE STOPPED";
+		else
+			emulatorStatus = compareWithEmulator();
+
+		if (emulatorStatus.size())
+		{
+			emulatorStatus = "LOCKSTEP INSTR " + std::to_string(emulator.instructions) + ": " + emulatorStatus;
+			simulationPaused = true;
+		}
+		else
+			emulatorStatus = "LOCKSTEP INSTR " + std::to_string(emulator.instructions) + " OK";
+
+		redrawRequired = true;
+	}
+
+	RamStore loadProgram(std::string programName)
 	{
+		RamStore program;
+		program.resize(16);
+
+		// Binary images are mapped straight into the RAM instead of being copied.
+		if (program.mapImage("programs/" + programName + ".bin"))
+			return program;
+
 		std::vector<std::vector<int>> blank = {
 		{ 0, 0, 0, 0, 0, 0, 0, 0 },
 		{ 0, 0, 0, 0, 0, 0, 0, 0 },
@@ -3870,34 +9299,74 @@ private:
 		{ 0, 0, 0, 0, 0, 0, 0, 0 },
 		{ 0, 0, 0, 0, 0, 0, 0, 0 } };
 
+		std::vector<std::vector<int>> programBits = blank;
+
 		if (programName == "add")
-			return add;
+			programBits = add;
 
 		if (programName == "multiplesOfThree")
-			return multiplesOfThree;
+			programBits = multiplesOfThree;
 
 		if (programName == "multiplesOfSix")
-			return multiplesOfSix;
+			programBits = multiplesOfSix;
 
 		if (programName == "conditionals")
-			return conditionals;
+			programBits = conditionals;
 
 		if (programName == "multiply")
-			return multiply;
+			programBits = multiply;
 
 		if (programName == "divide")
-			return divide;
+			programBits = divide;
 
 		if (programName == "fibonacci")
-			return fibonacci;
-		
-		return blank;
+			programBits = fibonacci;
+
+		for (int address = 0; address < programBits.size(); address++)
+		{
+			uint8_t word = 0;
+			for (int bit = 0; bit < 8; bit++)
+				word |= programBits[address][bit] << (7 - bit);
+
+			program.write(address, word);
+		}
+
+		return program;
 	}
 };
 
-int main()
+int main(int argc, char* argv[])
 {
 	Viscom vc;
+	long long cycles = 0;
+
+	if (argc >= 4 && (std::string(argv[1]) == "--headless" || std::string(argv[1]) == "--activity") && !Viscom::parseCycles(argv[3], cycles))
+	{
+		std::cout << "Usage: viscom " << argv[1] << " <save timestamp> <clock cycles> [option], not a number of clock cycles: " << argv[3] << std::endl;
+		return 1;
+	}
+	if (argc >= 4 && std::string(argv[1]) == "--headless")
+		return vc.RunHeadless(argv[2], cycles, argc >= 5 ? argv[4] : "");
+	if (argc >= 4 && std::string(argv[1]) == "--activity")
+		return vc.RunActivity(argv[2], cycles, argc >= 5 ? argv[4] : "");
+	if (argc >= 2 && std::string(argv[1]) == "--benchmark-load")
+		return vc.BenchmarkLoad();
+	if (argc >= 2 && std::string(argv[1]) == "--benchmark-parse")
+		return vc.BenchmarkParse();
+	if (argc >= 3 && std::string(argv[1]) == "--render")
+		return vc.RenderDesigns(std::vector<std::string>(argv + 2, argv + argc));
+	if (argc >= 4 && std::string(argv[1]) == "--diff")
+		return vc.DiffRenders(argv[2], argv[3], argc >= 5 ? argv[4] : "");
+	if (argc >= 2 && std::string(argv[1]) == "--catalog")
+		return vc.ListCatalog(argc >= 3 ? argv[2] : "");
+	if (argc >= 4 && std::string(argv[1]) == "--rename")
+		return vc.RenameDesign(argv[2], argv[3]);
+	if (argc >= 2 && std::string(argv[1]) == "--history")
+		return vc.ListHistory(argc >= 3 ? argv[2] : "");
+	if (argc >= 3 && std::string(argv[1]) == "--import")
+		return vc.ImportHistory(std::vector<std::string>(argv + 2, argv + argc));
+	if (argc >= 3 && std::string(argv[1]) == "--open" && !vc.OpenDesign(argv[2]))
+		return 1;
 	if (vc.Construct(1600, 900, 1, 1, false))
 		vc.Start();
 